@@ -0,0 +1,80 @@
+/* Collects figures from the benchmarks so the test runner can write them out
+ as JSON, to compare one release with the next.
+
+ Each result is a benchmark name, the parameters it ran with and the figures
+ it measured.  A tool comparing two files should match results on the name
+ and parameters, and compare the metrics.
+ */
+
+class BenchmarkResults
+{
+public:
+    static BenchmarkResults& getInstance()
+    {
+        static BenchmarkResults instance;
+        return instance;
+    }
+
+    void add(const String& benchmark, const NamedValueSet& parameters, const NamedValueSet& metrics)
+    {
+        DynamicObject::Ptr result = new DynamicObject();
+        result->setProperty("benchmark", benchmark);
+        result->setProperty("parameters", toObject(parameters));
+        result->setProperty("metrics", toObject(metrics));
+        results.add(var(result.get()));
+    }
+
+    int getNumResults() const
+    {
+        return results.size();
+    }
+
+    void clear()
+    {
+        results.clear();
+    }
+
+    /** The results, along with enough about the machine and build to tell
+     whether two files are worth comparing. */
+    String toJSON() const
+    {
+        DynamicObject::Ptr machine = new DynamicObject();
+        machine->setProperty("os", SystemStats::getOperatingSystemName());
+        machine->setProperty("cpuVendor", SystemStats::getCpuVendor());
+        machine->setProperty("numCpus", SystemStats::getNumCpus());
+        machine->setProperty("cpuSpeedMHz", SystemStats::getCpuSpeedInMegahertz());
+
+        DynamicObject::Ptr root = new DynamicObject();
+        root->setProperty("formatVersion", 1);
+        root->setProperty("date", Time::getCurrentTime().toISO8601(true));
+        root->setProperty("juceVersion", SystemStats::getJUCEVersion());
+       #if JUCE_DEBUG
+        root->setProperty("build", "debug");
+       #else
+        root->setProperty("build", "release");
+       #endif
+        root->setProperty("machine", var(machine.get()));
+        root->setProperty("results", var(results));
+
+        return JSON::toString(var(root.get()));
+    }
+
+    bool writeTo(const File& file) const
+    {
+        return file.replaceWithText(toJSON());
+    }
+
+private:
+    BenchmarkResults() {}
+
+    static var toObject(const NamedValueSet& values)
+    {
+        DynamicObject::Ptr object = new DynamicObject();
+        object->getProperties() = values;
+        return var(object.get());
+    }
+
+    Array<var> results;
+
+    JUCE_DECLARE_NON_COPYABLE(BenchmarkResults)
+};
@@ -0,0 +1,202 @@
+
+#if defined (__cpp_impl_coroutine)
+
+class CallQueueCoroutinesTest
+:
+public UnitTest
+{
+public:
+    CallQueueCoroutinesTest()
+    :
+    UnitTest("Call Queue Coroutine Tests")
+    {
+    }
+
+    /** Where a coroutine has got to, and whether each hop worked. */
+    struct Progress
+    {
+        int step = 0;
+        bool hops[2] = { false, false };
+    };
+
+    static CallQueueTask pingPong(CoroutineFramePool&, LockFreeCallQueue& toAudio,
+                                  MessageThreadCallQueue& toMessageThread, Progress& progress)
+    {
+        progress.step = 1;
+        progress.hops[0] = co_await onCriticalThread(toAudio);
+        progress.step = 2;
+        progress.hops[1] = co_await onMessageThread(toMessageThread);
+        progress.step = 3;
+    }
+
+    void testFramePool()
+    {
+        beginTest("Frame Pool");
+        CoroutineFramePool pool(4, 256);
+        void* frames[4];
+
+        for (int i = 0; i < 4; ++i)
+        {
+            frames[i] = pool.allocate(200);
+            expect(frames[i] != nullptr);
+            expect(reinterpret_cast<size_t>(frames[i]) % alignof(std::max_align_t) == 0);
+            memset(frames[i], i, 200);
+        }
+
+        expect(pool.getNumFramesInUse() == 4);
+        expect(pool.allocate(16) == nullptr);
+
+        CoroutineFramePool::deallocate(frames[2]);
+        void* again = pool.allocate(16);
+        expect(again == frames[2]);
+
+        for (int i = 0; i < 4; ++i)
+            CoroutineFramePool::deallocate(frames[i]);
+
+        expect(pool.getNumFramesInUse() == 0);
+    }
+
+    /** Each step runs only when the queue it hopped through is drained. */
+    void testHops()
+    {
+        beginTest("Hops");
+        CoroutineFramePool pool(8, 512);
+        LockFreeCallQueue toAudio(4096);
+        MessageThreadCallQueue toMessageThread(4096);
+        Progress progress;
+
+        expect(pingPong(pool, toAudio, toMessageThread, progress).wasStarted());
+        expect(progress.step == 1);
+        expect(pool.getNumFramesInUse() == 1);
+
+        toMessageThread.synchronize();
+        expect(progress.step == 1);
+
+        toAudio.synchronize();
+        expect(progress.step == 2);
+        expect(progress.hops[0]);
+
+        toMessageThread.synchronize();
+        expect(progress.step == 3);
+        expect(progress.hops[1]);
+
+        /* The frame freed itself at the end. */
+        expect(pool.getNumFramesInUse() == 0);
+    }
+
+    /** An empty pool stops the coroutine starting, and a full queue makes
+     the hop fail without suspending. */
+    void testFailures()
+    {
+        beginTest("Failures");
+        CoroutineFramePool pool(1, 512);
+        LockFreeCallQueue toAudio(4096);
+        MessageThreadCallQueue toMessageThread(4096);
+        Progress first, second;
+
+        expect(pingPong(pool, toAudio, toMessageThread, first).wasStarted());
+        expect(! pingPong(pool, toAudio, toMessageThread, second).wasStarted());
+        expect(second.step == 0);
+
+        toAudio.synchronize();
+        toMessageThread.synchronize();
+        expect(first.step == 3);
+
+        LockFreeCallQueue full(256);
+
+        while (full.callf([]() {}))
+        {}
+
+        Progress third;
+        expect(pingPong(pool, full, toMessageThread, third).wasStarted());
+        expect(third.step == 2);
+        expect(! third.hops[0]);
+
+        toMessageThread.synchronize();
+        expect(third.step == 3);
+        expect(pool.getNumFramesInUse() == 0);
+        full.synchronize();
+    }
+
+    class AudioThread
+    :
+    public Thread
+    {
+    public:
+        AudioThread(LockFreeCallQueue& q)
+        :
+        Thread("Audio Thread"),
+        queue(q)
+        {}
+
+        void run() override
+        {
+            while (! threadShouldExit())
+                if (! queue.synchronize())
+                    yield();
+
+            queue.synchronize();
+        }
+
+        LockFreeCallQueue& queue;
+    };
+
+    static CallQueueTask checkThreads(CoroutineFramePool&, LockFreeCallQueue& toAudio,
+                                      MessageThreadCallQueue& toMessageThread, Thread* audioThread,
+                                      std::atomic<int>& errors, std::atomic<int>& numFinished)
+    {
+        const bool hoppedToAudio = co_await onCriticalThread(toAudio);
+
+        if (! hoppedToAudio || Thread::getCurrentThread() != audioThread)
+            errors++;
+
+        const bool hoppedBack = co_await onMessageThread(toMessageThread);
+
+        if (! hoppedBack || Thread::getCurrentThread() == audioThread)
+            errors++;
+
+        numFinished++;
+    }
+
+    /** Coroutines really do run on the thread they hop to, with the pool
+     shared between them. */
+    void testThreaded()
+    {
+        beginTest("Threaded");
+        CoroutineFramePool pool(64, 512);
+        LockFreeCallQueue toAudio(65536);
+        MessageThreadCallQueue toMessageThread(65536);
+        AudioThread audio(toAudio);
+        audio.startThread();
+
+        std::atomic<int> errors(0);
+        std::atomic<int> numFinished(0);
+        const int numCoroutines = 20000;
+        int numStarted = 0;
+        const uint32 startTime = Time::getMillisecondCounter();
+
+        while (numFinished < numCoroutines && Time::getMillisecondCounter() - startTime < 20000)
+        {
+            if (numStarted < numCoroutines
+                && checkThreads(pool, toAudio, toMessageThread, &audio, errors, numFinished).wasStarted())
+                numStarted++;
+
+            toMessageThread.synchronize();
+        }
+
+        audio.stopThread(1000);
+        expect(numFinished == numCoroutines);
+        expect(errors == 0);
+        expect(pool.getNumFramesInUse() == 0);
+    }
+
+    void runTest() override
+    {
+        testFramePool();
+        testHops();
+        testFailures();
+        testThreaded();
+    }
+};
+
+#endif
@@ -0,0 +1,412 @@
+/* Benchmarks for LockFreeCallQueue.
+
+ These don't pass or fail, they log timings.  The interesting number for the
+ slot layout is cross-core cache traffic, which you'll need a profiler to see,
+ e.g. on Linux:
+
+     perf stat -e cache-misses,cache-references,LLC-load-misses <test runner>
+
+ Run it against the build you want to compare with and diff the counts.  Pin
+ the test runner to two physical cores (taskset) to get stable figures.
+ */
+
+class CallQueueBenchmark
+:
+public UnitTest
+{
+public:
+    CallQueueBenchmark()
+    :
+    UnitTest("Call Queue Benchmarks")
+    {}
+
+    /** Stand-in for a plugin's parameter handling. */
+    class ParameterTarget
+    {
+    public:
+        ParameterTarget()
+        {
+            for (auto& v : values)
+                v = 0.0f;
+        }
+
+        void setParam (int index, float value)
+        {
+            values[index & 63] = value;
+            ++count;
+        }
+
+        float values[64];
+        uint64 count = 0;
+    };
+
+    /** Stand-in for the audio thread.  Spins on synchronize() so every callf()
+     is picked up as quickly as possible, which is the worst case for the two
+     threads sharing cache lines. */
+    class ConsumerThread
+    :
+    public Thread
+    {
+    public:
+        ConsumerThread (LockFreeCallQueue& q)
+        :
+        Thread ("Benchmark Consumer"),
+        queue (q)
+        {}
+
+        void run() override
+        {
+            while (! threadShouldExit())
+                queue.synchronize();
+
+            queue.synchronize();
+        }
+
+    private:
+        LockFreeCallQueue& queue;
+    };
+
+    /** Parameter automation at a fixed rate - calls are paced with the
+     high resolution clock rather than sent in a burst. */
+    void benchmarkParameterAutomation (int callsPerSecond, double durationSeconds)
+    {
+        beginTest("Parameter automation at " + String(callsPerSecond) + " calls/sec");
+
+        LockFreeCallQueue queue (16384);
+        ParameterTarget target;
+        ConsumerThread consumer (queue);
+        consumer.startThread();
+
+        const int64 ticksPerSecond = Time::getHighResolutionTicksPerSecond();
+        const int64 ticksPerCall = jmax ((int64) 1, ticksPerSecond / callsPerSecond);
+        const int64 start = Time::getHighResolutionTicks();
+        const int64 end = start + (int64) (durationSeconds * ticksPerSecond);
+
+        int64 nextCall = start;
+        int64 ticksInCallf = 0;
+        int calls = 0;
+        int dropped = 0;
+
+        while (nextCall < end)
+        {
+            while (Time::getHighResolutionTicks() < nextCall)
+            {}
+
+            const int64 before = Time::getHighResolutionTicks();
+
+            if (! queue.callf (std::bind (&ParameterTarget::setParam, &target, calls, (float) calls)))
+                ++dropped;
+
+            ticksInCallf += Time::getHighResolutionTicks() - before;
+            nextCall += ticksPerCall;
+            ++calls;
+        }
+
+        consumer.stopThread (500);
+
+        const double nsPerCall = Time::highResolutionTicksToSeconds (ticksInCallf) * 1.0e9 / calls;
+        logMessage("calls: " + String(calls) + " dropped: " + String(dropped)
+                   + " executed: " + String((int64) target.count)
+                   + " mean callf: " + String(nsPerCall, 1) + "ns");
+
+        expect(target.count == (uint64) (calls - dropped));
+    }
+
+    /** Unpaced - the producer retries whenever the queue is full. */
+    void benchmarkThroughput (int numCalls, int queueSize)
+    {
+        beginTest("Throughput with a " + String(queueSize) + " byte queue");
+
+        LockFreeCallQueue queue (queueSize);
+        ParameterTarget target;
+        ConsumerThread consumer (queue);
+        consumer.startThread();
+
+        int queueFullCounter = 0;
+        const int64 start = Time::getHighResolutionTicks();
+
+        for (int i = 0; i < numCalls; ++i)
+        {
+            while (! queue.callf (std::bind (&ParameterTarget::setParam, &target, i, (float) i)))
+                ++queueFullCounter;
+        }
+
+        while (! queue.isEmpty())
+        {}
+
+        const double seconds = Time::highResolutionTicksToSeconds (Time::getHighResolutionTicks() - start);
+        consumer.stopThread (500);
+
+        logMessage(String((int64) (numCalls / seconds)) + " calls/sec, queue was full "
+                   + String(queueFullCounter) + " times");
+
+        expect(target.count == (uint64) numCalls);
+    }
+
+    /** Bursts of calls, each drained before the next is sent.  Both sides
+     work through many calls at a time here, which is where each side
+     caching the other's position saves the most cache line transfers.
+     Compare the figure, and the perf counters, against an older build.
+
+     With batched set each burst goes through a Batch, so it's published with
+     a single store, like loading a preset. */
+    void benchmarkBursts (int numBursts, int callsPerBurst, bool batched = false)
+    {
+        beginTest("Bursts of " + String(callsPerBurst) + (batched ? " calls, batched" : " calls"));
+
+        LockFreeCallQueue queue (65536);
+        ParameterTarget target;
+        ConsumerThread consumer (queue);
+        consumer.startThread();
+
+        const int64 start = Time::getHighResolutionTicks();
+
+        for (int burst = 0; burst < numBursts; ++burst)
+        {
+            if (batched)
+            {
+                LockFreeCallQueue::Batch batch (queue);
+
+                for (int i = 0; i < callsPerBurst; ++i)
+                    batch.callf (&ParameterTarget::setParam, &target, i, (float) i);
+            }
+            else
+            {
+                for (int i = 0; i < callsPerBurst; ++i)
+                    while (! queue.callf (&ParameterTarget::setParam, &target, i, (float) i))
+                    {}
+            }
+
+            while (! queue.isEmpty())
+            {}
+        }
+
+        const double seconds = Time::highResolutionTicksToSeconds (Time::getHighResolutionTicks() - start);
+        consumer.stopThread (500);
+
+        logMessage(String((int64) ((double) numBursts * callsPerBurst / seconds)) + " calls/sec");
+        expect(target.count == (uint64) numBursts * (uint64) callsPerBurst);
+    }
+
+    /** A functor of a given size that bumps a counter.  Trivial ones take the
+     WorkItem fast path, the others have a destructor to call.  The pointer
+     shares its bytes with the payload, so even the 8 byte one is exactly the
+     size asked for. */
+    template <int size, bool trivial>
+    struct SizedFunctor
+    {
+        void operator()() { ++target->count; }
+
+        union
+        {
+            ParameterTarget* target;
+            char payload[size];
+        };
+    };
+
+    template <int size>
+    struct SizedFunctor<size, false>
+    {
+        ~SizedFunctor() { target->values[0] = 0.0f; }
+        void operator()() { ++target->count; }
+
+        union
+        {
+            ParameterTarget* target;
+            char payload[size];
+        };
+    };
+
+    /** Single threaded - callf() until full, then synchronize() - so the
+     figure is the cost of copying and dispatching, without any cache
+     traffic between cores. */
+    template <int size, bool trivial>
+    void benchmarkFunctorSize()
+    {
+        static_assert (sizeof (SizedFunctor<size, trivial>) == size, "the functor should be the size under test");
+
+        LockFreeCallQueue queue (65536);
+        ParameterTarget target;
+        SizedFunctor<size, trivial> f;
+        f.target = &target;
+
+        const int rounds = 2000;
+        const int64 start = Time::getHighResolutionTicks();
+
+        for (int i = 0; i < rounds; ++i)
+        {
+            while (queue.callf (f))
+            {}
+
+            queue.synchronize();
+        }
+
+        const double seconds = Time::highResolutionTicksToSeconds (Time::getHighResolutionTicks() - start);
+        logMessage(String(size) + (trivial ? " byte trivial functor: " : " byte functor with destructor: ")
+                   + String((int64) (target.count / seconds)) + " calls/sec");
+    }
+
+    template <class Functor>
+    double timeCalls (Functor const& f, ParameterTarget& target, int numCalls)
+    {
+        LockFreeCallQueue queue (65536);
+        const int64 start = Time::getHighResolutionTicks();
+
+        for (int i = 0; i < numCalls; ++i)
+        {
+            if (! queue.callf (f))
+            {
+                queue.synchronize();
+                queue.callf (f);
+            }
+        }
+
+        queue.synchronize();
+        expect(target.count == (uint64) numCalls);
+        target.count = 0;
+        return Time::highResolutionTicksToSeconds (Time::getHighResolutionTicks() - start);
+    }
+
+    void benchmarkFunctorSizes()
+    {
+        beginTest("Calls per second by functor size");
+
+        benchmarkFunctorSize<8, true>();
+        benchmarkFunctorSize<32, true>();
+        benchmarkFunctorSize<32, false>();
+        benchmarkFunctorSize<64, true>();
+        benchmarkFunctorSize<128, true>();
+        benchmarkFunctorSize<128, false>();
+        benchmarkFunctorSize<256, true>();
+        benchmarkFunctorSize<512, true>();
+        benchmarkFunctorSize<512, false>();
+
+        /* The usual parameter change, both ways of writing it. */
+        ParameterTarget target;
+        const int numCalls = 4000000;
+        const double bound = timeCalls (std::bind (&ParameterTarget::setParam, &target, 3, 0.5f), target, numCalls);
+        LockFreeCallQueue queue (65536);
+        int64 start = Time::getHighResolutionTicks();
+
+        for (int i = 0; i < numCalls; ++i)
+        {
+            if (! queue.callf (&ParameterTarget::setParam, &target, 3, 0.5f))
+            {
+                queue.synchronize();
+                queue.callf (&ParameterTarget::setParam, &target, 3, 0.5f);
+            }
+        }
+
+        queue.synchronize();
+        const double memberCall = Time::highResolutionTicksToSeconds (Time::getHighResolutionTicks() - start);
+        expect(target.count == (uint64) numCalls);
+
+        logMessage("std::bind setParam: " + String((int64) (numCalls / bound)) + " calls/sec, "
+                   + "callf (&X::setParam, ...): " + String((int64) (numCalls / memberCall)) + " calls/sec");
+    }
+
+    /** Stand-in for a plugin's render loop: a gain applied to a buffer,
+     where the gain is set by calls through the queue. */
+    class GainRenderer
+    {
+    public:
+        GainRenderer() : buffer(4096, 1.0f) {}
+
+        void setGain(float newGain)
+        {
+            gain = newGain;
+        }
+
+        void render(int start, int numSamples)
+        {
+            float* data = buffer.data() + start;
+
+            for (int i = 0; i < numSamples; ++i)
+                data[i] = data[i] * gain + 1.0e-3f;
+        }
+
+        std::vector<float> buffer;
+        float gain = 1.0f;
+    };
+
+    /** Renders the same automation - a gain change every callInterval
+     samples - once quantised to the block with synchronize() and once
+     sample accurately with callAt(), and logs the cost of the splitting. */
+    void benchmarkSampleAccurateSplit (int blockSize, int callInterval)
+    {
+        const int numBlocks = (48000 * 20) / blockSize;
+
+        double seconds[2];
+
+        for (int sampleAccurate = 0; sampleAccurate < 2; ++sampleAccurate)
+        {
+            LockFreeCallQueue queue (65536);
+            GainRenderer renderer;
+            int64 position = 0;
+            int64 nextCall = 0;
+
+            const int64 start = Time::getHighResolutionTicks();
+
+            for (int block = 0; block < numBlocks; ++block)
+            {
+                for (; nextCall < position + blockSize; nextCall += callInterval)
+                {
+                    const float gain = (float) (nextCall % 100) * 0.01f;
+
+                    if (sampleAccurate)
+                        queue.callAt (nextCall, &GainRenderer::setGain, &renderer, gain);
+                    else
+                        queue.callf (&GainRenderer::setGain, &renderer, gain);
+                }
+
+                if (sampleAccurate)
+                {
+                    int sectionStart = 0;
+
+                    while (sectionStart < blockSize)
+                    {
+                        queue.synchronizeUntil (position + sectionStart + 1);
+                        const int64 next = jlimit (position + sectionStart + 1, position + blockSize, queue.getNextCallTime());
+                        const int sectionEnd = (int) (next - position);
+                        renderer.render (sectionStart, sectionEnd - sectionStart);
+                        sectionStart = sectionEnd;
+                    }
+                }
+                else
+                {
+                    queue.synchronize();
+                    renderer.render (0, blockSize);
+                }
+
+                position += blockSize;
+            }
+
+            seconds[sampleAccurate] = Time::highResolutionTicksToSeconds (Time::getHighResolutionTicks() - start);
+            expect(queue.isEmpty());
+        }
+
+        const double nsPerBlock = (seconds[1] - seconds[0]) * 1.0e9 / numBlocks;
+        logMessage(String(blockSize) + " sample blocks: " + String(seconds[0] * 1000.0, 2) + "ms quantised, "
+                   + String(seconds[1] * 1000.0, 2) + "ms sample accurate, "
+                   + String(nsPerBlock, 1) + "ns per block for splitting");
+    }
+
+    void runTest() override
+    {
+        beginTest("Sample accurate split overhead, a call every 32 samples");
+
+        for (int blockSize = 64; blockSize <= 4096; blockSize *= 2)
+            benchmarkSampleAccurateSplit (blockSize, 32);
+
+        benchmarkFunctorSizes();
+        benchmarkParameterAutomation (1000000, 2.0);
+        benchmarkThroughput (4000000, 1024);
+        benchmarkThroughput (4000000, 65536);
+        benchmarkBursts (20000, 64);
+        benchmarkBursts (2000, 512);
+        benchmarkBursts (20000, 64, true);
+        benchmarkBursts (2000, 512, true);
+    }
+};
+
+static CallQueueBenchmark callQueueBenchmark;
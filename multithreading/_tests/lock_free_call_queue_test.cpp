@@ -111,10 +111,726 @@ public:
         expect(success == false);
     }
     
+    /** Check the budgeted versions of synchronize leave the rest for later. */
+    void testBudgetedSynchronize()
+    {
+        beginTest("Budgeted Synchronize");
+        LockFreeCallQueue budgetQueue(4096);
+        int executed = 0;
+
+        for (int i = 0; i < 10; ++i)
+            expect(budgetQueue.callf([&executed]() { executed++; }));
+
+        expect(budgetQueue.getNumPendingCalls() == 10);
+        expect(budgetQueue.synchronize(3) == 7);
+        expect(executed == 3);
+
+        /* Always makes some progress, even with no time at all. */
+        expect(budgetQueue.synchronize(RelativeTime(0.0)) == 6);
+        expect(executed == 4);
+
+        expect(budgetQueue.synchronize(RelativeTime::seconds(10.0)) == 0);
+        expect(executed == 10);
+        expect(budgetQueue.synchronize(5) == 0);
+        expect(budgetQueue.isEmpty());
+    }
+
+    /** Calls that don't fit before the end of the ring go to the start, and
+     must still come out whole and in order. */
+    void testWrapAround()
+    {
+        beginTest("Wrap Around");
+        LockFreeCallQueue wrapQueue(1024);
+        int executed = 0;
+        bool intact = true;
+
+        for (int i = 0; i < 100; ++i)
+        {
+            UpdateObject<400> object;
+            object.nextNumber = (uint64) i;
+            memset(object.padding, i, sizeof(object.padding));
+
+            /* Two of these fit before the end of the ring, the third has
+             to go back to the start. */
+            expect(wrapQueue.callf([&executed, &intact, object]()
+                                   {
+                                       for (auto c : object.padding)
+                                           intact = intact && c == (char) object.nextNumber;
+
+                                       intact = intact && object.nextNumber == (uint64) executed;
+                                       executed++;
+                                   }));
+
+            expect(wrapQueue.synchronize());
+        }
+
+        expect(executed == 100);
+        expect(intact);
+        expect(wrapQueue.isEmpty());
+    }
+
+    /** A target for callf (&Class::method, object, args...). */
+    class MemberCallTarget
+    {
+    public:
+        void set(int a, float b, String c) { total += a + (int) b; text = c; }
+        void setTotal(int t) { total = t; }
+        int total = 0;
+        String text;
+    };
+
+    /** The member function overload, with trivially copyable and
+     non-trivial arguments. */
+    void testMemberCall()
+    {
+        beginTest("Member Call");
+        LockFreeCallQueue memberQueue(4096);
+        MemberCallTarget target;
+
+        expect(memberQueue.callf(&MemberCallTarget::set, &target, 1, 2.0f, String("first")));
+        expect(memberQueue.callf(&MemberCallTarget::set, &target, 3, 4.0f, String("second")));
+        expect(target.total == 0);
+
+        memberQueue.synchronize();
+        expect(target.total == 10);
+        expect(target.text == "second");
+    }
+
+    /** A background consumer that sleeps in waitAndSynchronize(). */
+    class WaitingConsumer
+    :
+    public Thread
+    {
+    public:
+        WaitingConsumer()
+        :
+        Thread("Waiting Consumer"),
+        waitingQueue(4096, true),
+        count(0)
+        {}
+
+        void run() override
+        {
+            while (! threadShouldExit())
+                waitingQueue.waitAndSynchronize();
+        }
+
+        LockFreeCallQueue waitingQueue;
+        std::atomic<int> count;
+    };
+
+    void testWaitingConsumer()
+    {
+        beginTest("Waiting Consumer");
+        WaitingConsumer consumer;
+        consumer.startThread();
+
+        for (int i = 0; i < 200; ++i)
+        {
+            /* Long enough for the consumer to have gone to sleep each time. */
+            if (i % 10 == 0)
+                sleep(2);
+
+            std::atomic<int>* count = &consumer.count;
+            expect(consumer.waitingQueue.callf([count]() { (*count)++; }));
+        }
+
+        for (int i = 0; i < 100 && consumer.count < 200; ++i)
+            sleep(10);
+
+        expect(consumer.count == 200);
+
+        /* stop() wakes the consumer so it can see it should exit. */
+        consumer.signalThreadShouldExit();
+        consumer.waitingQueue.stop();
+        expect(consumer.waitForThreadToExit(500));
+    }
+
+    /** Round trips with callfWithResult(), first polled on one thread then
+     waited for from another. */
+    void testCallWithResult()
+    {
+        beginTest("Call With Result");
+        LockFreeCallQueue resultQueue(4096);
+        CallResult<int> result;
+        int state = 21;
+
+        expect(resultQueue.callfWithResult(result, [&state]() { return state * 2; }));
+        expect(result.isPending());
+        expect(! result.isReady());
+
+        resultQueue.synchronize();
+        expect(result.isReady());
+        expect(result.get() == 42);
+
+        WaitingConsumer consumer;
+        consumer.startThread();
+
+        for (int i = 0; i < 100; ++i)
+        {
+            expect(consumer.waitingQueue.callfWithResult(result, [i]() { return i * 3; }));
+            expect(result.waitForResult(1000));
+            expect(result.get() == i * 3);
+        }
+
+        consumer.signalThreadShouldExit();
+        consumer.waitingQueue.stop();
+        expect(consumer.waitForThreadToExit(500));
+    }
+
+    /** The counters and the latency histogram. */
+    void testStatistics()
+    {
+        beginTest("Statistics");
+        LockFreeCallQueue statsQueue(1024);
+        int executed = 0;
+
+        while (statsQueue.callf([&executed]() { executed++; }))
+        {}
+
+        expect(! statsQueue.callf([&executed]() { executed++; }));
+
+        CallQueueStatistics stats = statsQueue.getStatistics();
+        expect(stats.callsMade == 15);
+        expect(stats.callsExecuted == 0);
+        expect(stats.callsDropped == 2);
+        expect(stats.bufferSize == 1024);
+
+        statsQueue.synchronize();
+        stats = statsQueue.getStatistics();
+        expect(stats.callsExecuted == 15);
+        /* The consumer found the queue full when it got there. */
+        expect(stats.peakBytesUsed == 960);
+        expect(statsQueue.getLatencyHistogram().getTotalCount() == 0);
+
+        statsQueue.setMeasureLatency(true);
+
+        for (int i = 0; i < 10; ++i)
+            expect(statsQueue.callf([&executed]() { executed++; }));
+
+        statsQueue.synchronize();
+        expect(executed == 25);
+        expect(statsQueue.getLatencyHistogram().getTotalCount() == 10);
+    }
+
+    /** With spillToHeap a full queue keeps the calls, in order, until
+     there's room. */
+    void testSpillToHeap()
+    {
+        beginTest("Spill To Heap");
+        LockFreeCallQueue spillQueue(1024);
+        spillQueue.setOverflowPolicy(LockFreeCallQueue::spillToHeap);
+        int executed = 0;
+        bool inOrder = true;
+
+        for (int i = 0; i < 50; ++i)
+            expect(spillQueue.callf([&executed, &inOrder, i]()
+                                    {
+                                        inOrder = inOrder && i == executed;
+                                        executed++;
+                                    }));
+
+        expect(spillQueue.getNumSpilledCalls() == 35);
+        expect(spillQueue.getStatistics().callsSpilled == 35);
+        expect(spillQueue.getStatistics().callsDropped == 0);
+
+        while (! spillQueue.flushSpilledCalls())
+            spillQueue.synchronize();
+
+        spillQueue.synchronize();
+        expect(executed == 50);
+        expect(inOrder);
+        expect(spillQueue.getNumSpilledCalls() == 0);
+    }
+
+    /** A flood of calls on a few keys runs each key once, with the latest
+     value. */
+    void testCoalescedCalls()
+    {
+        beginTest("Coalesced Calls");
+        LockFreeCallQueue coalescingQueue(4096);
+        coalescingQueue.setNumCoalescingKeys(4);
+        MemberCallTarget target;
+        int executed = 0;
+
+        for (int i = 1; i <= 1000; ++i)
+        {
+            expect(coalescingQueue.callfCoalesced(0, [&executed, i]() { executed = i; }));
+            expect(coalescingQueue.callfCoalesced(1, &MemberCallTarget::setTotal, &target, i));
+        }
+
+        expect(coalescingQueue.getNumPendingCalls() == 2);
+
+        coalescingQueue.synchronize();
+        expect(executed == 1000);
+        expect(target.total == 1000);
+
+        /* The mailbox is empty again, so the next call is queued as normal. */
+        expect(coalescingQueue.callfCoalesced(0, [&executed]() { executed = -1; }));
+        expect(coalescingQueue.getNumPendingCalls() == 1);
+        coalescingQueue.synchronize();
+        expect(executed == -1);
+    }
+
+    /** Calls from callAt() wait for their sample, and a block split at
+     getNextCallTime() runs each one exactly where it's due. */
+    void testSampleTimedCalls()
+    {
+        beginTest("Sample Timed Calls");
+        LockFreeCallQueue timedQueue(4096);
+        std::vector<int64> ran;
+
+        expect(timedQueue.callAt(10, [&ran]() { ran.push_back(10); }));
+        expect(timedQueue.callf([&ran]() { ran.push_back(-1); }));
+        expect(timedQueue.callAt(20, [&ran]() { ran.push_back(20); }));
+
+        expect(timedQueue.getNextCallTime() == 10);
+        expect(! timedQueue.synchronizeUntil(10));
+        expect(timedQueue.synchronizeUntil(11));
+        expect(ran.size() == 2 && ran[0] == 10 && ran[1] == -1);
+        expect(timedQueue.getNextCallTime() == 20);
+        expect(timedQueue.synchronizeUntil(1000));
+        expect(timedQueue.getNextCallTime() == std::numeric_limits<int64>::max());
+
+        /* Render 100 blocks of 64 samples, with a call every 37 samples. */
+        const int blockSize = 64;
+        int64 position = 0;
+        int64 renderedTo = 0;
+        int64 nextCall = 0;
+        bool onTime = true;
+        ran.clear();
+
+        for (int block = 0; block < 100; ++block)
+        {
+            for (; nextCall < position + blockSize; nextCall += 37)
+            {
+                const int64 due = nextCall;
+                int64* now = &renderedTo;
+                expect(timedQueue.callAt(due, [&onTime, &ran, now, due]()
+                                         {
+                                             onTime = onTime && *now == due;
+                                             ran.push_back(due);
+                                         }));
+            }
+
+            int start = 0;
+
+            while (start < blockSize)
+            {
+                timedQueue.synchronizeUntil(position + start + 1);
+                const int64 next = jlimit(position + start + 1, position + blockSize, timedQueue.getNextCallTime());
+                start = (int) (next - position);
+                renderedTo = next;
+            }
+
+            position += blockSize;
+        }
+
+        /* renderedTo is the sample the next section starts at, which is
+         where each call should have landed. */
+        expect(ran.size() == (size_t) (nextCall / 37));
+        expect(onTime);
+    }
+
+    /** callAt() can't overtake spilled calls.  While they still don't fit
+     it drops the call rather than jump the queue. */
+    void testSampleTimedCallsAfterSpill()
+    {
+        beginTest("Sample Timed Calls After Spill");
+        LockFreeCallQueue spillQueue(1024);
+        spillQueue.setOverflowPolicy(LockFreeCallQueue::spillToHeap);
+        std::vector<int> ran;
+
+        for (int i = 0; i < 50; ++i)
+            expect(spillQueue.callf([&ran, i]() { ran.push_back(i); }));
+
+        expect(spillQueue.getNumSpilledCalls() == 35);
+        spillQueue.synchronize();
+
+        /* Room for this, but not for the spilled calls in front of it. */
+        expect(! spillQueue.callAt(0, [&ran]() { ran.push_back(-1); }));
+        expect(spillQueue.getStatistics().callsDropped == 1);
+
+        while (! spillQueue.flushSpilledCalls())
+            spillQueue.synchronize();
+
+        expect(spillQueue.callAt(0, [&ran]() { ran.push_back(50); }));
+        expect(spillQueue.synchronizeUntil(1));
+
+        expect(ran.size() == 51);
+
+        for (int i = 0; i < (int) ran.size(); ++i)
+            expect(ran[(size_t) i] == i);
+    }
+
+    /** Owns its argument, so it can be moved but not copied.  (C++11 lambdas
+     can't capture by move.) */
+    struct MoveOnlyCall
+    {
+        MoveOnlyCall(int v, int* t) : value(new int(v)), total(t) {}
+        MoveOnlyCall(MoveOnlyCall&& other) : value(std::move(other.value)), total(other.total) {}
+
+        int operator()() { *total += *value; return *value; }
+
+        std::unique_ptr<int> value;
+        int* total;
+
+        JUCE_DECLARE_NON_COPYABLE(MoveOnlyCall)
+    };
+
+    void testMoveOnlyCalls()
+    {
+        beginTest("Move Only Calls");
+        LockFreeCallQueue moveQueue(1024);
+        int total = 0;
+
+        MoveOnlyCall call(1, &total);
+        expect(moveQueue.callf(std::move(call)));
+        expect(call.value == nullptr);
+
+        while (moveQueue.callf(MoveOnlyCall(1, &total)))
+        {}
+
+        /* A dropped call mustn't take the functor with it. */
+        MoveOnlyCall dropped(100, &total);
+        expect(! moveQueue.callf(std::move(dropped)));
+        expect(dropped.value != nullptr);
+
+        moveQueue.synchronize();
+        expect(total == 15);
+
+        expect(moveQueue.callf(std::move(dropped)));
+        moveQueue.synchronize();
+        expect(total == 115);
+
+        CallResult<int> result;
+        expect(moveQueue.callfWithResult(result, MoveOnlyCall(7, &total)));
+        moveQueue.synchronize();
+        expect(result.isReady() && result.get() == 7);
+
+        moveQueue.setOverflowPolicy(LockFreeCallQueue::spillToHeap);
+        total = 0;
+
+        for (int i = 0; i < 20; ++i)
+            expect(moveQueue.callf(MoveOnlyCall(1, &total)));
+
+        expect(moveQueue.getNumSpilledCalls() > 0);
+
+        while (! moveQueue.flushSpilledCalls())
+            moveQueue.synchronize();
+
+        moveQueue.synchronize();
+        expect(total == 20);
+    }
+
+    void testPayloadCalls()
+    {
+        beginTest("Payload Calls");
+        LockFreeCallQueue payloadQueue(4096);
+        float samples[200];
+        float total = 0.0f;
+        int count = 0;
+
+        for (int i = 0; i < 200; ++i)
+            samples[i] = 1.0f;
+
+        auto sum = [&total, &count](const float* data, int numSamples)
+        {
+            for (int i = 0; i < numSamples; ++i)
+                total += data[i];
+
+            count++;
+        };
+
+        /* 800 bytes of payload each, so the ring wraps several times. */
+        for (int i = 0; i < 20; ++i)
+        {
+            expect(payloadQueue.callfWithPayload(samples, 200, sum));
+            expect(payloadQueue.callfWithPayload(samples, 100, sum));
+            samples[0] = 2.0f; // the queue has its own copy.
+            payloadQueue.synchronize();
+            samples[0] = 1.0f;
+        }
+
+        expect(count == 40);
+        expect(total == 20 * 300.0f);
+
+        expect(payloadQueue.callfWithPayload(samples, 0, sum));
+        payloadQueue.synchronize();
+        expect(count == 41);
+
+        /* Too big for the queue. */
+        float big[1024] = {};
+        expect(! payloadQueue.callfWithPayload(big, 1024, sum));
+        expect(payloadQueue.getStatistics().callsDropped == 1);
+
+        payloadQueue.synchronize();
+        expect(count == 41);
+        expect(payloadQueue.isEmpty());
+    }
+
+    void testBatch()
+    {
+        beginTest("Batch");
+        LockFreeCallQueue batchQueue(1024);
+        MemberCallTarget target;
+
+        {
+            LockFreeCallQueue::Batch batch(batchQueue);
+
+            for (int i = 1; i <= 10; ++i)
+                expect(batch.callf(&MemberCallTarget::setTotal, &target, i));
+
+            expect(batch.getNumCalls() == 10);
+            expect(batchQueue.isEmpty());
+        }
+
+        batchQueue.synchronize();
+        expect(target.total == 10);
+        expect(batchQueue.getStatistics().callsExecuted == 10);
+
+        /* 15 calls fit, so the 16th drops the whole batch, and the calls
+         already written are destroyed without running. */
+        std::shared_ptr<int> owned(new int(0));
+        int runs = 0;
+
+        {
+            LockFreeCallQueue::Batch batch(batchQueue);
+
+            for (int i = 0; i < 15; ++i)
+                expect(batch.callf([owned, &runs]() { runs++; }));
+
+            expect(owned.use_count() == 16);
+            expect(! batch.callf([owned, &runs]() { runs++; }));
+            expect(! batch.callf([owned, &runs]() { runs++; }));
+            expect(owned.use_count() == 1);
+            expect(! batch.commit());
+        }
+
+        expect(batchQueue.isEmpty());
+        batchQueue.synchronize();
+        expect(runs == 0);
+        expect(batchQueue.getStatistics().callsDropped == 17);
+
+        /* A batch can be committed in parts, and the queue carries on as
+         normal afterwards. */
+        LockFreeCallQueue::Batch batch(batchQueue);
+        expect(batch.callf([&runs]() { runs++; }));
+        expect(batch.commit());
+        expect(batch.callf([&runs]() { runs++; }));
+        batch.cancel();
+        expect(batch.commit());
+        batchQueue.synchronize();
+        expect(runs == 1);
+
+        expect(batchQueue.callf([&runs]() { runs++; }));
+        batchQueue.synchronize();
+        expect(runs == 2);
+
+        /* Calls added after a cancel() take the cancelled calls' place. */
+        std::vector<int> ran;
+        int numAlive = 0;
+
+        {
+            LockFreeCallQueue::Batch cancelled(batchQueue);
+            expect(cancelled.callf(CountedCall(1, &ran, &numAlive)));
+            expect(cancelled.callf(CountedCall(2, &ran, &numAlive)));
+            cancelled.cancel();
+            expect(numAlive == 0);
+
+            expect(cancelled.callf(CountedCall(3, &ran, &numAlive)));
+            expect(cancelled.callf(CountedCall(4, &ran, &numAlive)));
+            expect(cancelled.getNumCalls() == 2);
+        }
+
+        batchQueue.synchronize();
+        expect(ran.size() == 2 && ran[0] == 3 && ran[1] == 4);
+        expect(numAlive == 0);
+        expect(batchQueue.isEmpty());
+    }
+
+    /** Counts its live copies, so a call destroyed twice, or not at all,
+     shows up. */
+    struct CountedCall
+    {
+        CountedCall(int i, std::vector<int>* r, int* n) : id(i), ran(r), numAlive(n) { ++*numAlive; }
+        CountedCall(const CountedCall& other) : id(other.id), ran(other.ran), numAlive(other.numAlive) { ++*numAlive; }
+        ~CountedCall() { --*numAlive; }
+
+        void operator()() { ran->push_back(id); }
+
+        int id;
+        std::vector<int>* ran;
+        int* numAlive;
+    };
+
+    void testGrow()
+    {
+        beginTest("Grow");
+        LockFreeCallQueue growQueue(1024);
+        int executed = 0;
+        bool inOrder = true;
+        int next = 0;
+
+        auto call = [&executed, &inOrder](int i)
+        {
+            inOrder = inOrder && i == executed;
+            executed++;
+        };
+
+        for (int i = 0; i < 10; ++i, ++next)
+            expect(growQueue.callf([call, next]() { call(next); }));
+
+        /* The calls in the old ring go first. */
+        expect(growQueue.grow(4096));
+        expect(growQueue.getStatistics().bufferSize == 4096);
+
+        for (int i = 0; i < 50; ++i, ++next)
+            expect(growQueue.callf([call, next]() { call(next); }));
+
+        /* Can't replace the new ring until the consumer has left the old one. */
+        expect(! growQueue.grow(8192));
+        expect(growQueue.getNumPendingCalls() == 60);
+
+        growQueue.synchronize();
+        expect(executed == 60);
+        expect(inOrder);
+        expect(growQueue.isEmpty());
+
+        expect(! growQueue.grow(4096));
+        expect(growQueue.grow(8192));
+        expect(growQueue.callf([call, next]() { call(next); }));
+        growQueue.synchronize();
+        expect(executed == 61);
+        expect(inOrder);
+
+        /* No room in a full ring for the handoff. */
+        LockFreeCallQueue fullQueue(1024);
+
+        while (fullQueue.callf([](){}))
+        {}
+
+        expect(! fullQueue.grow(2048));
+        fullQueue.synchronize();
+        expect(fullQueue.grow(2048));
+    }
+
+    /** Polls getFreeSpace() while the producer grows the queue, which frees
+     the rings it replaces. */
+    class FreeSpaceWatcher
+    :
+    public Thread
+    {
+    public:
+        FreeSpaceWatcher(LockFreeCallQueue& q, int max)
+        :
+        Thread("Free Space Watcher"),
+        queue(q),
+        maxFreeSpace(max)
+        {}
+
+        void run() override
+        {
+            while (! threadShouldExit())
+            {
+                const int freeSpace = queue.getFreeSpace();
+
+                if (freeSpace < 0 || freeSpace > maxFreeSpace)
+                    outOfRange = true;
+            }
+        }
+
+        LockFreeCallQueue& queue;
+        const int maxFreeSpace;
+        std::atomic<bool> outOfRange { false };
+    };
+
+    void testFreeSpaceWhileGrowing()
+    {
+        beginTest("Free Space While Growing");
+        const int maxSize = 1 << 20;
+        LockFreeCallQueue growQueue(1024);
+        FreeSpaceWatcher watcher(growQueue, maxSize);
+        watcher.startThread();
+
+        for (int size = 2048; size <= maxSize; size *= 2)
+        {
+            for (int i = 0; i < 10; ++i)
+                expect(growQueue.callf([](){}));
+
+            expect(growQueue.grow(size));
+            growQueue.synchronize();
+        }
+
+        watcher.stopThread(1000);
+        expect(! watcher.outOfRange);
+        expect(growQueue.getFreeSpace() == maxSize - 64);
+    }
+
+    void testLockMemory()
+    {
+        beginTest("Lock Memory");
+        const int64 lockedBefore = RealtimeMemoryLock::getTotalLockedBytes();
+
+        {
+            LockFreeCallQueue lockedQueue(65536);
+
+            /* The OS may refuse, under a low ulimit -l say, but the queue must
+             work either way. */
+            if (lockedQueue.lockMemory())
+                expect(RealtimeMemoryLock::getTotalLockedBytes() >= lockedBefore + 65536);
+            else
+                expect(RealtimeMemoryLock::getTotalLockedBytes() == lockedBefore);
+
+            int count = 0;
+            expect(lockedQueue.callf([&count]() { count++; }));
+            expect(lockedQueue.grow(131072));
+            expect(lockedQueue.callf([&count]() { count++; }));
+            lockedQueue.synchronize();
+            expect(count == 2);
+        }
+
+        expect(RealtimeMemoryLock::getTotalLockedBytes() == lockedBefore);
+
+        /* Two blocks sharing a page.  It's counted once, and stays locked
+         until both have let go. */
+        const int pageSize = SystemStats::getPageSize();
+        std::vector<char> buffer((size_t) pageSize * 4);
+        char* const page = buffer.data() + (pageSize - (int) (reinterpret_cast<size_t>(buffer.data()) % (size_t) pageSize));
+        RealtimeMemoryLock first, second;
+
+        if (first.lock(page, (size_t) pageSize / 2) && second.lock(page + pageSize / 2, (size_t) pageSize))
+        {
+            expect(RealtimeMemoryLock::getTotalLockedBytes() == lockedBefore + 2 * pageSize);
+            first.unlock();
+            expect(RealtimeMemoryLock::getTotalLockedBytes() == lockedBefore + 2 * pageSize);
+            second.unlock();
+        }
+
+        first.unlock();
+        expect(RealtimeMemoryLock::getTotalLockedBytes() == lockedBefore);
+    }
+
     void runTest() override
     {
         testNormalOperation();
         testQueueFull();
+        testBudgetedSynchronize();
+        testMemberCall();
+        testWrapAround();
+        testWaitingConsumer();
+        testCallWithResult();
+        testStatistics();
+        testSpillToHeap();
+        testCoalescedCalls();
+        testSampleTimedCalls();
+        testSampleTimedCallsAfterSpill();
+        testMoveOnlyCalls();
+        testPayloadCalls();
+        testBatch();
+        testGrow();
+        testFreeSpaceWhileGrowing();
+        testLockMemory();
     }
     
     void run()
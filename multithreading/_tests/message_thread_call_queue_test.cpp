@@ -0,0 +1,149 @@
+
+class MessageThreadCallQueueTest
+:
+public UnitTest
+{
+public:
+    MessageThreadCallQueueTest()
+    :
+    UnitTest("Message Thread Call Queue Tests")
+    {
+    }
+
+    /** Stand-in for a meter on the GUI. */
+    class Meter
+    {
+    public:
+        void setLevel(float newLevel)
+        {
+            level = newLevel;
+            numUpdates++;
+        }
+
+        float level = 0.0f;
+        int numUpdates = 0;
+    };
+
+    /** However many calls arrive between drains, only one wakeup is
+     posted. */
+    void testCoalescing()
+    {
+        beginTest("Coalescing");
+        MessageThreadCallQueue queue(65536);
+        Meter meter;
+
+        for (int i = 0; i < 100; ++i)
+            expect(queue.callf(&Meter::setLevel, &meter, (float) i));
+
+        expect(queue.getNumWakeupsPosted() == 1);
+        expect(queue.getNumPendingCalls() == 100);
+
+        queue.synchronize();
+        expect(meter.numUpdates == 100);
+        expect(meter.level == 99.0f);
+        expect(queue.getNumPendingCalls() == 0);
+
+        /* The next call after a drain posts a fresh wakeup. */
+        queue.callf([&meter]() { meter.numUpdates++; });
+        queue.callf([&meter]() { meter.numUpdates++; });
+        expect(queue.getNumWakeupsPosted() == 2);
+
+        queue.synchronize();
+        expect(meter.numUpdates == 102);
+    }
+
+    /** A drain that runs out of time leaves the rest queued, and asks for
+     another drain. */
+    void testDrainTime()
+    {
+        beginTest("Drain Time");
+        MessageThreadCallQueue queue(65536);
+        queue.setMaxDrainTime(RelativeTime::milliseconds(1));
+        int numRun = 0;
+
+        for (int i = 0; i < 20; ++i)
+            queue.callf([&numRun]() { numRun++; Thread::sleep(1); });
+
+        expect(queue.getNumWakeupsPosted() == 1);
+        queue.synchronize();
+        expect(numRun > 0 && numRun < 20);
+        expect(queue.getNumWakeupsPosted() == 2);
+
+        while (queue.getNumPendingCalls() > 0)
+            queue.synchronize();
+
+        expect(numRun == 20);
+    }
+
+    class AudioThread
+    :
+    public Thread
+    {
+    public:
+        AudioThread(MessageThreadCallQueue& q, Meter& m, int n)
+        :
+        Thread("Audio Thread"),
+        queue(q),
+        meter(m),
+        numCalls(n)
+        {}
+
+        void run() override
+        {
+            for (int i = 0; i < numCalls; ++i)
+            {
+                while (! queue.callf(&Meter::setLevel, &meter, (float) i))
+                    yield();
+            }
+        }
+
+        MessageThreadCallQueue& queue;
+        Meter& meter;
+        const int numCalls;
+    };
+
+    /** Calls made while the message thread is draining are never left
+     behind without a wakeup, and there's never more than one wakeup per
+     drain. */
+    void testThreaded()
+    {
+        beginTest("Threaded");
+        MessageThreadCallQueue queue(16384);
+        Meter meter;
+        const int numCalls = 200000;
+        AudioThread audio(queue, meter, numCalls);
+        audio.startThread();
+
+        int numDrains = 0;
+        uint32 wakeupsSeen = 0;
+        const uint32 startTime = Time::getMillisecondCounter();
+
+        while (meter.numUpdates < numCalls && Time::getMillisecondCounter() - startTime < 20000)
+        {
+            /* Only drain when a wakeup has been posted, as the message thread
+             would. */
+            const uint32 wakeups = queue.getNumWakeupsPosted();
+
+            if (wakeups == wakeupsSeen)
+            {
+                Thread::yield();
+                continue;
+            }
+
+            wakeupsSeen = wakeups;
+            queue.synchronize();
+            numDrains++;
+        }
+
+        audio.stopThread(1000);
+        expect(meter.numUpdates == numCalls);
+        expect(queue.getNumWakeupsPosted() <= (uint32) numDrains + 1);
+    }
+
+    void runTest() override
+    {
+        testCoalescing();
+        testDrainTime();
+        testThreaded();
+    }
+};
@@ -0,0 +1,181 @@
+
+class MultiProducerCallQueueTest
+:
+public UnitTest
+{
+public:
+    MultiProducerCallQueueTest()
+    :
+    UnitTest("Multi Producer Call Queue Tests"),
+    queue(4096)
+    {
+    }
+
+    enum
+    {
+        numProducers = 8,
+        callsPerProducer = 50000
+    };
+
+    template <int paddingSize>
+    class UpdateObject
+    {
+    public:
+        int producer;
+        uint64 nextNumber;
+        char padding[paddingSize];
+    };
+
+    /** Each producer sends an increasing sequence of numbers.  Calls from
+     different producers interleave, but each producer's should arrive in
+     order. */
+    class Producer
+    :
+    public Thread
+    {
+    public:
+        Producer(MultiProducerCallQueueTest& t, int producerIndex)
+        :
+        Thread("Producer " + String(producerIndex)),
+        test(t),
+        index(producerIndex),
+        queueFullCounter(0)
+        {}
+
+        void run() override
+        {
+            Random rand;
+            rand.setSeedRandomly();
+
+            for (uint64 i = 1; i <= callsPerProducer; ++i)
+            {
+                while (! post(rand, i))
+                {
+                    queueFullCounter++;
+                    yield();
+                }
+
+                if (rand.nextFloat() > 0.999f)
+                    sleep(1);
+            }
+        }
+
+        bool post(Random& rand, uint64 number)
+        {
+            if (rand.nextFloat() > 0.5f)
+                return test.queue.callf(std::bind(&MultiProducerCallQueueTest::receive, &test, index, number));
+
+            UpdateObject<100> object;
+            object.producer = index;
+            object.nextNumber = number;
+            MultiProducerCallQueueTest* t = &test;
+
+            return test.queue.callf([t, object]()
+                                    {
+                                        t->receive(object.producer, object.nextNumber);
+                                    });
+        }
+
+        MultiProducerCallQueueTest& test;
+        int index;
+        uint64 queueFullCounter;
+    };
+
+    void testManyProducers()
+    {
+        beginTest("Many Producers");
+
+        for (int i = 0; i < numProducers; ++i)
+            lastReceived[i] = 0;
+
+        errorCount = 0;
+        receivedCount = 0;
+
+        OwnedArray<Producer> producers;
+
+        for (int i = 0; i < numProducers; ++i)
+            producers.add(new Producer(*this, i));
+
+        for (auto* p : producers)
+            p->startThread();
+
+        const uint64 expectedCount = (uint64) numProducers * callsPerProducer;
+
+        /* This thread is the consumer. */
+        while (receivedCount < expectedCount)
+        {
+            if (! queue.synchronize())
+                Thread::yield();
+        }
+
+        for (auto* p : producers)
+        {
+            expect(p->waitForThreadToExit(1000));
+            Logger::outputDebugString(p->getThreadName() + " found the queue full " + String(p->queueFullCounter) + " times");
+        }
+
+        expect(errorCount == 0);
+        expect(receivedCount == expectedCount);
+        expect(queue.isEmpty());
+        expect(! queue.synchronize());
+
+        for (int i = 0; i < numProducers; ++i)
+            expect(lastReceived[i] == callsPerProducer);
+    }
+
+    /** Check that the queue full flag actually works. */
+    void testQueueFull()
+    {
+        beginTest("Test Queue Full");
+
+        bool success = true;
+
+        for (int i = 0; i < 500; ++i)
+        {
+            UpdateObject<128> object;
+            object.producer = 0;
+            object.nextNumber = 0;
+            MultiProducerCallQueueTest* t = this;
+
+            success = queue.callf([t, object]()
+                                  {
+                                      t->receive(object.producer, object.nextNumber);
+                                  });
+        }
+
+        expect(success == false);
+
+        /* Drain without checking anything. */
+        checkOrder = false;
+        queue.synchronize();
+        checkOrder = true;
+        expect(queue.isEmpty());
+    }
+
+    void runTest() override
+    {
+        checkOrder = true;
+        testManyProducers();
+        testQueueFull();
+    }
+
+    void receive(int producer, uint64 number)
+    {
+        receivedCount++;
+
+        if (! checkOrder)
+            return;
+
+        if (number != lastReceived[producer] + 1)
+            errorCount++;
+
+        lastReceived[producer] = number;
+    }
+
+    uint64 lastReceived[numProducers];
+    uint64 errorCount;
+    uint64 receivedCount;
+    bool checkOrder;
+
+    MultiProducerCallQueue queue;
+};
@@ -0,0 +1,134 @@
+
+class PriorityCallQueueTest
+:
+public UnitTest
+{
+public:
+    PriorityCallQueueTest()
+    :
+    UnitTest("Priority Call Queue Tests")
+    {
+    }
+
+    enum
+    {
+        urgent,
+        normal,
+        cosmetic,
+        numLanes
+    };
+
+    /** Records the order calls arrive in. */
+    class Recorder
+    {
+    public:
+        void record(int lane, int index)
+        {
+            order.push_back(lane * 10000 + index);
+        }
+
+        std::vector<int> order;
+    };
+
+    /** Urgent calls made after a flood of cosmetic ones still run first. */
+    void testLaneOrder()
+    {
+        beginTest("Lane Order");
+        PriorityCallQueue queue(numLanes, 65536);
+        Recorder recorder;
+
+        for (int i = 0; i < 500; ++i)
+            expect(queue.callf(cosmetic, &Recorder::record, &recorder, (int) cosmetic, i));
+
+        for (int i = 0; i < 5; ++i)
+        {
+            expect(queue.callf(normal, &Recorder::record, &recorder, (int) normal, i));
+            expect(queue.callf(urgent, &Recorder::record, &recorder, (int) urgent, i));
+        }
+
+        expect(queue.synchronize());
+        expect(recorder.order.size() == 510);
+
+        for (int i = 0; i < 5; ++i)
+        {
+            expect(recorder.order[i] == urgent * 10000 + i);
+            expect(recorder.order[5 + i] == normal * 10000 + i);
+        }
+
+        for (int i = 0; i < 500; ++i)
+            expect(recorder.order[10 + i] == cosmetic * 10000 + i);
+
+        expect(! queue.synchronize());
+    }
+
+    /** A budgeted lane is drained a bit at a time, and the urgent lane
+     still gets through on every synchronize(). */
+    void testLaneBudget()
+    {
+        beginTest("Lane Budget");
+        PriorityCallQueue queue(numLanes, 65536);
+        queue.setLaneBudget(cosmetic, 100);
+        Recorder recorder;
+
+        for (int i = 0; i < 250; ++i)
+            expect(queue.callf(cosmetic, &Recorder::record, &recorder, (int) cosmetic, i));
+
+        for (int block = 0; block < 3; ++block)
+        {
+            recorder.order.clear();
+            expect(queue.callf(urgent, &Recorder::record, &recorder, (int) urgent, block));
+            expect(queue.synchronize());
+
+            expect(recorder.order.front() == urgent * 10000 + block);
+            expect(recorder.order.size() == (block < 2 ? 101u : 51u));
+        }
+
+        expect(queue.getNumPendingCalls(cosmetic) == 0);
+    }
+
+    /** A budgeted lane whose calls make more calls than they use up.  There
+     are more calls waiting afterwards than before, but synchronize() still
+     did something. */
+    void testBudgetWithNewCalls()
+    {
+        beginTest("Budget With New Calls");
+        PriorityCallQueue queue(1, 4096);
+        queue.setLaneBudget(0, 1);
+        int numCalls = 0;
+
+        std::function<void()> call = [&queue, &call, &numCalls]
+        {
+            if (++numCalls < 3)
+            {
+                queue.callf(0, call);
+                queue.callf(0, call);
+            }
+        };
+
+        expect(queue.callf(0, call));
+        expect(queue.synchronize());
+        expect(numCalls == 1);
+        expect(queue.getNumPendingCalls(0) == 2);
+        expect(queue.synchronize());
+        expect(numCalls == 2);
+    }
+
+    /** The lanes are made with new, and their positions are padded out to
+     cache lines, so they have to start on one. */
+    void testLaneAlignment()
+    {
+        beginTest("Lane Alignment");
+        PriorityCallQueue queue(numLanes, 4096);
+
+        for (int i = 0; i < numLanes; ++i)
+            expect((reinterpret_cast<size_t>(&queue.getLane(i)) & 63) == 0);
+    }
+
+    void runTest() override
+    {
+        testLaneOrder();
+        testLaneBudget();
+        testBudgetWithNewCalls();
+        testLaneAlignment();
+    }
+};
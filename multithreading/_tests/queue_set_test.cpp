@@ -0,0 +1,171 @@
+
+class QueueSetTest
+:
+public UnitTest
+{
+public:
+    QueueSetTest()
+    :
+    UnitTest("Queue Set Tests")
+    {
+    }
+
+    /** Only the queues that have been sent calls are flagged, and
+     synchronize() clears the flags as it drains them. */
+    void testReadyMask()
+    {
+        beginTest("Ready Mask");
+        OwnedArray<LockFreeCallQueue> queues;
+        QueueSet set;
+
+        for (int i = 0; i < 10; ++i)
+        {
+            queues.add(new LockFreeCallQueue(4096));
+            expect(set.add(*queues[i]));
+        }
+
+        expect(set.getNumQueues() == 10);
+
+        /* New queues are flagged, in case they already had calls. */
+        expect(set.getReadyMask() == 0x3ff);
+        expect(! set.synchronize());
+        expect(set.getReadyMask() == 0);
+
+        int total = 0;
+        queues[2]->callf([&total]() { total += 1; });
+        queues[7]->callf([&total]() { total += 10; });
+        queues[7]->callf([&total]() { total += 100; });
+        expect(set.getReadyMask() == ((1 << 2) | (1 << 7)));
+
+        expect(set.synchronize());
+        expect(total == 111);
+        expect(set.getReadyMask() == 0);
+
+        for (auto q : queues)
+            expect(q->isEmpty());
+
+        /* A removed queue is no longer flagged, and its slot is reused. */
+        set.remove(*queues[3]);
+        expect(set.getNumQueues() == 9);
+        queues[3]->callf([&total]() { total += 1000; });
+        expect(set.getReadyMask() == 0);
+        expect(! set.synchronize());
+        expect(total == 111);
+
+        LockFreeCallQueue another(4096);
+        expect(set.add(another));
+        expect(set.getReadyMask() == (1 << 3));
+
+        queues[3]->synchronize();
+        expect(total == 1111);
+        set.remove(another);
+    }
+
+    /** A budgeted synchronize() leaves queues with calls over flagged. */
+    void testBudget()
+    {
+        beginTest("Budget");
+        LockFreeCallQueue busy(65536);
+        LockFreeCallQueue quiet(4096);
+        QueueSet set;
+        set.add(busy);
+        set.add(quiet);
+        set.synchronize();
+
+        int busyCalls = 0;
+        int quietCalls = 0;
+
+        for (int i = 0; i < 25; ++i)
+            busy.callf([&busyCalls]() { busyCalls++; });
+
+        quiet.callf([&quietCalls]() { quietCalls++; });
+
+        expect(set.synchronize(10) == 1);
+        expect(busyCalls == 10 && quietCalls == 1);
+        expect(set.getReadyMask() == 1);
+
+        expect(set.synchronize(10) == 1);
+        expect(set.synchronize(10) == 0);
+        expect(busyCalls == 25);
+        expect(set.getReadyMask() == 0);
+    }
+
+    class Producer
+    :
+    public Thread
+    {
+    public:
+        Producer(LockFreeCallQueue& q, int n)
+        :
+        Thread("Queue Set Producer"),
+        queue(q),
+        numCalls(n)
+        {}
+
+        void run() override
+        {
+            for (int i = 0; i < numCalls; ++i)
+            {
+                while (! queue.callf([this]() { received++; }))
+                    yield();
+            }
+        }
+
+        LockFreeCallQueue& queue;
+        const int numCalls;
+        int received = 0;       /* consumer only. */
+    };
+
+    /** Several producers, each with its own queue, and one consumer
+     draining them all through the set.  No call may be left behind. */
+    void testThreaded()
+    {
+        beginTest("Threaded");
+        const int numProducers = 4;
+        const int numCalls = 50000;
+
+        OwnedArray<LockFreeCallQueue> queues;
+        OwnedArray<Producer> producers;
+        QueueSet set;
+
+        for (int i = 0; i < numProducers; ++i)
+        {
+            queues.add(new LockFreeCallQueue(4096));
+            set.add(*queues[i]);
+            producers.add(new Producer(*queues[i], numCalls));
+        }
+
+        for (auto p : producers)
+            p->startThread();
+
+        const uint32 startTime = Time::getMillisecondCounter();
+        int total = 0;
+
+        while (total < numProducers * numCalls && Time::getMillisecondCounter() - startTime < 20000)
+        {
+            if (! set.synchronize())
+                Thread::yield();
+
+            total = 0;
+
+            for (auto p : producers)
+                total += p->received;
+        }
+
+        for (auto p : producers)
+        {
+            p->stopThread(1000);
+            expect(p->received == numCalls);
+        }
+
+        for (auto q : queues)
+            set.remove(*q);
+    }
+
+    void runTest() override
+    {
+        testReadyMask();
+        testBudget();
+        testThreaded();
+    }
+};
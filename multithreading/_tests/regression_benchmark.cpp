@@ -0,0 +1,379 @@
+/* Benchmarks for tracking regressions from one release to the next.
+
+ Like the other benchmarks these log timings rather than pass or fail, but
+ every figure also goes into BenchmarkResults, which the test runner writes
+ out as JSON.  Keep the benchmark names and parameters stable: a tool
+ comparing two runs matches results on them.
+
+ Covers LockFreeCallQueue throughput and latency across functor sizes,
+ queue sizes and core pinning, what each GarbageCollector timer callback
+ costs, and how long CriticalThreadValueTree takes to send changes and apply
+ them.
+
+ Use a release build.  In a debug build the GarbageCollector checks every
+ new object against its whole list, and CriticalThreadValueTree logs each
+ tree it replaces, which swamps the figures.  The GarbageCollector and
+ CriticalThreadValueTree parts only run on the message thread.
+ */
+
+class RegressionBenchmark
+:
+public UnitTest
+{
+public:
+    RegressionBenchmark()
+    :
+    UnitTest("Regression Benchmarks")
+    {}
+
+    /** A call of exactly size bytes.  The producer stores the time it sent
+     the call where sentAt points, and the call replaces that with how long
+     it took to arrive. */
+    template <int size>
+    struct TimedCall
+    {
+        void operator()()
+        {
+            *sentAt = Time::getHighResolutionTicks() - *sentAt;
+        }
+
+        union
+        {
+            int64* sentAt;
+            char payload[size];
+        };
+    };
+
+    /** Stand-in for the audio thread, spinning on synchronize().  Both
+     sides yield while they wait, so the figures still mean something on a
+     machine with fewer cores than threads. */
+    class ConsumerThread
+    :
+    public Thread
+    {
+    public:
+        ConsumerThread(LockFreeCallQueue& q)
+        :
+        Thread("Regression Benchmark Consumer"),
+        queue(q)
+        {}
+
+        void run() override
+        {
+            while (! threadShouldExit())
+                if (! queue.synchronize())
+                    yield();
+
+            queue.synchronize();
+        }
+
+    private:
+        LockFreeCallQueue& queue;
+    };
+
+    /** Stamps the time just before each attempt, so a retry after finding
+     the queue full isn't counted as time in the queue. */
+    template <class Call>
+    static bool sendCall(LockFreeCallQueue& queue, const Call& call, int64& sentAt)
+    {
+        sentAt = Time::getHighResolutionTicks();
+        return queue.callf(call);
+    }
+
+    /** Sorts the latencies, and returns the percentiles in nanoseconds. */
+    static NamedValueSet getPercentiles(std::vector<int64>& latencies)
+    {
+        std::sort(latencies.begin(), latencies.end());
+
+        auto at = [&latencies] (double fraction)
+        {
+            const size_t index = jmin(latencies.size() - 1, (size_t) (fraction * (double) latencies.size()));
+            return Time::highResolutionTicksToSeconds(latencies[index]) * 1.0e9;
+        };
+
+        NamedValueSet result;
+        result.set("p50Ns", at(0.5));
+        result.set("p90Ns", at(0.9));
+        result.set("p99Ns", at(0.99));
+        result.set("p999Ns", at(0.999));
+        result.set("maxNs", at(1.0));
+        return result;
+    }
+
+    static String describeLatency(const NamedValueSet& percentiles)
+    {
+        return "median " + String((double) percentiles["p50Ns"], 0) + "ns, 99% "
+               + String((double) percentiles["p99Ns"], 0) + "ns, 99.9% "
+               + String((double) percentiles["p999Ns"], 0) + "ns";
+    }
+
+    /** One functor size through one queue size.  First flat out, with the
+     producer retrying whenever the queue is full, where the latency is
+     mostly time spent waiting behind a full queue and grows with its size.
+     Then paced, where the latency is how quickly the consumer notices a
+     call. */
+    template <int size>
+    void benchmarkCallQueue(int queueSize, bool pinned)
+    {
+        static_assert(sizeof(TimedCall<size>) == size, "the functor should be the size under test");
+
+        const int numCalls = 1000000;
+        const int numPacedCalls = 20000;
+        const int pacedCallsPerSecond = 50000;
+        const String pinning(pinned ? "separate cores" : "none");
+
+        std::vector<int64> times((size_t) numCalls);
+        LockFreeCallQueue queue(queueSize);
+        ConsumerThread consumer(queue);
+
+        if (pinned)
+        {
+            consumer.setAffinityMask(1u << 1);
+            Thread::setCurrentThreadAffinityMask(1u << 0);
+        }
+
+        consumer.startThread();
+
+        TimedCall<size> call;
+        const int64 start = Time::getHighResolutionTicks();
+
+        for (int i = 0; i < numCalls; ++i)
+        {
+            call.sentAt = &times[(size_t) i];
+
+            while (! sendCall(queue, call, times[(size_t) i]))
+                Thread::yield();
+        }
+
+        while (! queue.isEmpty())
+            Thread::yield();
+
+        const double seconds = Time::highResolutionTicksToSeconds(Time::getHighResolutionTicks() - start);
+
+        NamedValueSet flatOut(getPercentiles(times));
+        flatOut.set("callsPerSecond", (double) numCalls / seconds);
+
+        times.resize((size_t) numPacedCalls);
+        const int64 ticksPerCall = Time::getHighResolutionTicksPerSecond() / pacedCallsPerSecond;
+        int64 nextCall = Time::getHighResolutionTicks();
+
+        for (int i = 0; i < numPacedCalls; ++i)
+        {
+            while (Time::getHighResolutionTicks() < nextCall)
+                Thread::yield();
+
+            call.sentAt = &times[(size_t) i];
+
+            while (! sendCall(queue, call, times[(size_t) i]))
+                Thread::yield();
+
+            nextCall += ticksPerCall;
+        }
+
+        consumer.stopThread(500);
+
+        if (pinned)
+            Thread::setCurrentThreadAffinityMask(getAllCoresMask());
+
+        const NamedValueSet paced(getPercentiles(times));
+
+        BenchmarkResults::getInstance().add("LockFreeCallQueue flat out",
+                                            { { "functorBytes", size }, { "queueBytes", queueSize }, { "pinning", pinning } },
+                                            flatOut);
+        BenchmarkResults::getInstance().add("LockFreeCallQueue paced",
+                                            { { "functorBytes", size }, { "queueBytes", queueSize }, { "pinning", pinning },
+                                              { "callsPerSecond", pacedCallsPerSecond } },
+                                            paced);
+
+        logMessage(String(size) + " byte calls: " + String((int64) (double) flatOut["callsPerSecond"]) + " calls/sec, "
+                   + describeLatency(flatOut) + ".  Paced: " + describeLatency(paced));
+    }
+
+    static uint32 getAllCoresMask()
+    {
+        const int numCpus = SystemStats::getNumCpus();
+        return numCpus >= 32 ? ~(uint32) 0 : (((uint32) 1 << numCpus) - 1);
+    }
+
+    /** Pinning puts the producer and the consumer on cores 0 and 1, so the
+     figures don't depend on where the scheduler happens to put them.  It
+     does nothing on macOS. */
+    void benchmarkCallQueues()
+    {
+        const int queueSizes[] = { 4096, 65536, 1 << 20 };
+        const int numPinnings = SystemStats::getNumCpus() >= 2 ? 2 : 1;
+
+        for (int pinned = 0; pinned < numPinnings; ++pinned)
+        {
+            for (int queueSize : queueSizes)
+            {
+                beginTest("LockFreeCallQueue with a " + String(queueSize) + " byte queue"
+                          + (pinned ? ", pinned" : ""));
+
+                benchmarkCallQueue<8>(queueSize, pinned != 0);
+                benchmarkCallQueue<64>(queueSize, pinned != 0);
+                benchmarkCallQueue<128>(queueSize, pinned != 0);
+                benchmarkCallQueue<256>(queueSize, pinned != 0);
+                benchmarkCallQueue<512>(queueSize, pinned != 0);
+            }
+        }
+    }
+
+    class Garbage
+    :
+    public GarbageCollectedObject
+    {
+    public:
+        typedef ReferenceCountedObjectPtr<Garbage> Ptr;
+        char payload[128];
+    };
+
+    /** What a timer callback costs with numObjects alive, and with all of
+     them ready to delete. */
+    void benchmarkGarbageCollector(int numObjects)
+    {
+        beginTest("GarbageCollector with " + String(numObjects) + " objects");
+
+        GarbageCollector* collector = GarbageCollector::getInstance();
+        collector->collectGarbage();
+        const int numAlreadyThere = collector->getNumObjects();
+
+        std::vector<Garbage::Ptr> held;
+        held.reserve((size_t) numObjects);
+
+        int64 start = Time::getHighResolutionTicks();
+
+        for (int i = 0; i < numObjects; ++i)
+            held.push_back(new Garbage());
+
+        const double addSeconds = Time::highResolutionTicksToSeconds(Time::getHighResolutionTicks() - start);
+
+        start = Time::getHighResolutionTicks();
+        const int numDeletedWhileHeld = collector->collectGarbage();
+        const double idleSeconds = Time::highResolutionTicksToSeconds(Time::getHighResolutionTicks() - start);
+
+        held.clear();
+
+        start = Time::getHighResolutionTicks();
+        const int numDeleted = collector->collectGarbage();
+        const double reclaimSeconds = Time::highResolutionTicksToSeconds(Time::getHighResolutionTicks() - start);
+
+        expect(numDeletedWhileHeld == 0);
+        expect(numDeleted == numObjects);
+        expect(collector->getNumObjects() == numAlreadyThere);
+
+        const NamedValueSet metrics { { "addNsPerObject", addSeconds * 1.0e9 / numObjects },
+                                      { "idleCallbackUs", idleSeconds * 1.0e6 },
+                                      { "reclaimCallbackUs", reclaimSeconds * 1.0e6 },
+                                      { "reclaimNsPerObject", reclaimSeconds * 1.0e9 / numObjects } };
+
+        BenchmarkResults::getInstance().add("GarbageCollector", { { "numObjects", numObjects } }, metrics);
+
+        logMessage("timer callback " + String(idleSeconds * 1.0e6, 1) + "us with nothing to delete, "
+                   + String(reclaimSeconds * 1.0e6, 1) + "us deleting everything");
+    }
+
+    /** A tree of numNodes nodes, each with a few numeric properties, as a
+     plugin's settings might be.  Property changes go across as single calls,
+     anything else copies the whole tree. */
+    void benchmarkValueTreeClone(int numNodes)
+    {
+        beginTest("CriticalThreadValueTree with " + String(numNodes) + " nodes");
+
+        const int numProperties = 8;
+        const int numChanges = 1000;
+        const int numCopies = 20;
+
+        Array<Identifier> properties;
+
+        for (int i = 0; i < numProperties; ++i)
+            properties.add(Identifier("p" + String(i)));
+
+        ValueTree source("root");
+
+        for (int i = 1; i < numNodes; ++i)
+        {
+            ValueTree node("node");
+
+            for (int j = 0; j < numProperties; ++j)
+                node.setProperty(properties[j], (double) j, nullptr);
+
+            source.addChild(node, -1, nullptr);
+        }
+
+        LockFreeCallQueue queue(1 << 20);
+        CriticalThreadValueTree clone(source, queue);
+        queue.synchronize();
+
+        int64 start = Time::getHighResolutionTicks();
+
+        for (int i = 0; i < numChanges; ++i)
+            source.getChild(i % source.getNumChildren()).setProperty(properties[i % numProperties], i + 0.5, nullptr);
+
+        const double sendChangeSeconds = Time::highResolutionTicksToSeconds(Time::getHighResolutionTicks() - start);
+
+        start = Time::getHighResolutionTicks();
+        queue.synchronize();
+        const double applyChangeSeconds = Time::highResolutionTicksToSeconds(Time::getHighResolutionTicks() - start);
+
+        const int lastChange = numChanges - 1;
+        const var lastValue = clone.readonly->getReference().getChild(lastChange % source.getNumChildren())
+                                                            .getProperty(properties[lastChange % numProperties]);
+        expect((double) lastValue == lastChange + 0.5);
+
+        start = Time::getHighResolutionTicks();
+
+        for (int i = 0; i < numCopies; ++i)
+            clone.syncAll();
+
+        const double sendCopySeconds = Time::highResolutionTicksToSeconds(Time::getHighResolutionTicks() - start);
+
+        start = Time::getHighResolutionTicks();
+        queue.synchronize();
+        const double applyCopySeconds = Time::highResolutionTicksToSeconds(Time::getHighResolutionTicks() - start);
+
+        expect(clone.readonly->getReference().getNumChildren() == numNodes - 1);
+
+        /* The copies the critical thread has let go of. */
+        start = Time::getHighResolutionTicks();
+        GarbageCollector::getInstance()->collectGarbage();
+        const double reclaimSeconds = Time::highResolutionTicksToSeconds(Time::getHighResolutionTicks() - start);
+
+        const NamedValueSet metrics { { "sendPropertyChangeNs", sendChangeSeconds * 1.0e9 / numChanges },
+                                      { "applyPropertyChangeNs", applyChangeSeconds * 1.0e9 / numChanges },
+                                      { "sendTreeCopyUs", sendCopySeconds * 1.0e6 / numCopies },
+                                      { "applyTreeCopyUs", applyCopySeconds * 1.0e6 / numCopies },
+                                      { "reclaimTreeCopyUs", reclaimSeconds * 1.0e6 / numCopies } };
+
+        BenchmarkResults::getInstance().add("CriticalThreadValueTree",
+                                            { { "numNodes", numNodes }, { "numProperties", numProperties } },
+                                            metrics);
+
+        logMessage("property change " + String(sendChangeSeconds * 1.0e9 / numChanges, 0) + "ns to send, "
+                   + String(applyChangeSeconds * 1.0e9 / numChanges, 0) + "ns to apply.  Tree copy "
+                   + String(sendCopySeconds * 1.0e6 / numCopies, 1) + "us to send");
+    }
+
+    void runTest() override
+    {
+        benchmarkCallQueues();
+
+        MessageManager* messageManager = MessageManager::getInstanceWithoutCreating();
+
+        if (messageManager == nullptr || ! messageManager->isThisTheMessageThread())
+        {
+            logMessage("Not on the message thread, so skipping GarbageCollector and CriticalThreadValueTree");
+            return;
+        }
+
+        benchmarkGarbageCollector(1000);
+        benchmarkGarbageCollector(10000);
+        benchmarkGarbageCollector(50000);
+
+        benchmarkValueTreeClone(10);
+        benchmarkValueTreeClone(100);
+        benchmarkValueTreeClone(1000);
+    }
+};
+
+static RegressionBenchmark regressionBenchmark;
@@ -0,0 +1,216 @@
+/* Two-process benchmarks for SharedMemoryMessageQueue.
+
+ The test runner forks, and the child process plays the sandbox: it reads
+ from one queue and answers on another.  Like the other benchmarks these
+ log timings rather than pass or fail.  POSIX only, as it needs fork().
+ */
+
+#if JUCE_LINUX || JUCE_MAC
+
+class SharedMemoryMessageQueueBenchmark
+:
+public UnitTest
+{
+public:
+    SharedMemoryMessageQueueBenchmark()
+    :
+    UnitTest("Shared Memory Message Queue Benchmarks")
+    {}
+
+    enum
+    {
+        ping,
+        data,
+        finished,
+        quit
+    };
+
+    struct Record
+    {
+        int64 sequence;
+        int64 payload[6];
+    };
+
+    /** The child: answer every ping with the same record, and every
+     finished with the number of data records seen, until told to quit.  If
+     spin is set it polls synchronize() like an audio thread, otherwise it
+     sleeps in waitAndSynchronize(). */
+    static void runChild (SharedMemoryMessageQueue& in, SharedMemoryMessageQueue& out, bool spin)
+    {
+        int64 numReceived = 0;
+        bool running = true;
+
+        auto handle = [&] (int type, const void* p, int numBytes)
+        {
+            Record r;
+            memcpy (&r, p, (size_t) jmin (numBytes, (int) sizeof (r)));
+
+            if (type == ping)
+            {
+                while (! out.write (ping, r))
+                {}
+            }
+            else if (type == data)
+            {
+                numReceived++;
+            }
+            else if (type == finished)
+            {
+                r.sequence = numReceived;
+                numReceived = 0;
+
+                while (! out.write (finished, r))
+                {}
+            }
+            else
+            {
+                running = false;
+            }
+        };
+
+        while (running && in.isValid())
+        {
+            if (spin)
+                in.synchronize (handle);
+            else
+                in.waitAndSynchronize (handle, 100);
+        }
+    }
+
+    /** Wait for one record of the given type, from the parent's side. */
+    static Record waitFor (SharedMemoryMessageQueue& in, int expectedType, bool spin)
+    {
+        Record result = {};
+        bool received = false;
+
+        while (! received && in.isValid())
+        {
+            auto handle = [&] (int type, const void* p, int numBytes)
+            {
+                if (type == expectedType)
+                {
+                    memcpy (&result, p, (size_t) jmin (numBytes, (int) sizeof (result)));
+                    received = true;
+                }
+            };
+
+            if (spin)
+                in.synchronize (handle);
+            else
+                in.waitAndSynchronize (handle, 100);
+        }
+
+        return result;
+    }
+
+    /** Round trips, one at a time.  With spin clear both sides sleep on the
+     futex between records, so this is mostly the cost of waking a process. */
+    void benchmarkLatency (SharedMemoryMessageQueue& toChild, SharedMemoryMessageQueue& fromChild,
+                           bool spin, int numRoundTrips)
+    {
+        beginTest(spin ? "Round trip latency, polling" : "Round trip latency, futex");
+
+        Array<double> times;
+
+        for (int i = 0; i < numRoundTrips; ++i)
+        {
+            Record r = {};
+            r.sequence = i;
+            const int64 start = Time::getHighResolutionTicks();
+
+            while (! toChild.write (ping, r))
+            {}
+
+            const Record echo = waitFor (fromChild, ping, spin);
+
+            times.add (Time::highResolutionTicksToSeconds (Time::getHighResolutionTicks() - start) * 1.0e6);
+            expect(echo.sequence == i);
+        }
+
+        std::sort (times.begin(), times.end());
+        logMessage("median " + String(times[numRoundTrips / 2], 2) + " us, 99th percentile "
+                    + String(times[numRoundTrips * 99 / 100], 2) + " us");
+    }
+
+    /** Records per second, with the writer retrying whenever the ring is
+     full. */
+    void benchmarkThroughput (SharedMemoryMessageQueue& toChild, SharedMemoryMessageQueue& fromChild,
+                              int numRecords)
+    {
+        beginTest("Throughput");
+
+        Record r = {};
+        const int64 start = Time::getHighResolutionTicks();
+
+        for (int i = 0; i < numRecords; ++i)
+        {
+            r.sequence = i;
+
+            while (! toChild.write (data, r))
+            {}
+        }
+
+        while (! toChild.write (finished, r))
+        {}
+
+        const Record count = waitFor (fromChild, finished, false);
+        const double seconds = Time::highResolutionTicksToSeconds (Time::getHighResolutionTicks() - start);
+
+        expect(count.sequence == numRecords);
+        logMessage(String((int64) (numRecords / seconds)) + " records/sec, "
+                    + String((int) sizeof (Record)) + " bytes each");
+    }
+
+    void runWithChild (bool childSpins, std::function<void (SharedMemoryMessageQueue&, SharedMemoryMessageQueue&)> body)
+    {
+        const String name = "/smq-bench-" + String::toHexString(Time::getHighResolutionTicks());
+        SharedMemoryMessageQueue toChild (name + "a", 1 << 16);
+        SharedMemoryMessageQueue fromChild (name + "b", 1 << 16);
+
+        if (! toChild.isValid() || ! fromChild.isValid())
+        {
+            expect(false, "couldn't create shared memory");
+            return;
+        }
+
+        const pid_t child = fork();
+
+        if (child == 0)
+        {
+            /* The child has copies of both objects, mapping the same memory.
+             _exit() so it doesn't run the parent's destructors. */
+            runChild (toChild, fromChild, childSpins);
+            _exit (0);
+        }
+
+        expect(child > 0);
+
+        if (child > 0)
+        {
+            body (toChild, fromChild);
+
+            while (! toChild.write (quit, nullptr, 0))
+            {}
+
+            waitpid (child, nullptr, 0);
+        }
+    }
+
+    void runTest() override
+    {
+        runWithChild (false, [this] (SharedMemoryMessageQueue& to, SharedMemoryMessageQueue& from)
+        {
+            benchmarkLatency (to, from, false, 20000);
+            benchmarkThroughput (to, from, 5000000);
+        });
+
+        runWithChild (true, [this] (SharedMemoryMessageQueue& to, SharedMemoryMessageQueue& from)
+        {
+            benchmarkLatency (to, from, true, 5000);
+        });
+    }
+};
+
+static SharedMemoryMessageQueueBenchmark sharedMemoryMessageQueueBenchmark;
+
+#endif
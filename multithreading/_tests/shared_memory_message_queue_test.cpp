@@ -0,0 +1,194 @@
+
+class SharedMemoryMessageQueueTest
+:
+public UnitTest
+{
+public:
+    SharedMemoryMessageQueueTest()
+    :
+    UnitTest("Shared Memory Message Queue Tests")
+    {
+    }
+
+    enum
+    {
+        noteOn,
+        parameterChange,
+        block
+    };
+
+    struct ParameterChange
+    {
+        int index;
+        float value;
+    };
+
+    /** A name no other run of the tests will be using. */
+    static String makeName()
+    {
+        return "/smq-" + String::toHexString(Time::getHighResolutionTicks());
+    }
+
+    /** Both ends are opened in this process, which maps the same memory
+     twice, just as two processes would. */
+    void testCreateAndOpen()
+    {
+        beginTest("Create And Open");
+        const String name = makeName();
+
+        SharedMemoryMessageQueue missing(name);
+        expect(! missing.isValid());
+
+        SharedMemoryMessageQueue writer(name, 4000);
+        expect(writer.isValid());
+        expect(writer.getBufferSize() == 4032);
+
+        SharedMemoryMessageQueue duplicate(name, 4096);
+        expect(! duplicate.isValid());
+
+        SharedMemoryMessageQueue reader(name);
+        expect(reader.isValid());
+        expect(reader.getBufferSize() == 4032);
+        expect(reader.isEmpty());
+
+        expect(writer.write(parameterChange, ParameterChange { 3, 0.5f }));
+        expect(writer.write(noteOn, nullptr, 0));
+        expect(! reader.isEmpty());
+
+        int numChecked = 0;
+
+        const int n = reader.synchronize([this, &numChecked] (int type, const void* data, int numBytes)
+        {
+            if (numChecked == 0)
+            {
+                ParameterChange change;
+                expect(type == parameterChange && numBytes == (int) sizeof(change));
+                memcpy(&change, data, sizeof(change));
+                expect(change.index == 3 && change.value == 0.5f);
+            }
+            else
+            {
+                expect(type == noteOn && numBytes == 0);
+            }
+
+            numChecked++;
+        });
+
+        expect(n == 2 && numChecked == 2);
+        expect(reader.isEmpty());
+    }
+
+    /** Records of every size, through a small ring, so they wrap round the
+     end many times and the writer often finds it full. */
+    void testWrapAround()
+    {
+        beginTest("Wrap Around");
+        const String name = makeName();
+        SharedMemoryMessageQueue writer(name, 1024);
+        SharedMemoryMessageQueue reader(name);
+
+        uint8 buffer[300];
+        int next = 0;
+        int expected = 0;
+        int errors = 0;
+
+        auto check = [&expected, &errors] (int type, const void* data, int numBytes)
+        {
+            const uint8* bytes = static_cast<const uint8*> (data);
+
+            if (type != block || numBytes != expected % 300)
+                errors++;
+
+            for (int i = 0; i < numBytes; ++i)
+                if (bytes[i] != (uint8) (expected + i))
+                    errors++;
+
+            expected++;
+        };
+
+        while (next < 3000)
+        {
+            for (int i = 0; i < next % 300; ++i)
+                buffer[i] = (uint8) (next + i);
+
+            if (writer.write(block, buffer, next % 300))
+                next++;
+            else
+                reader.synchronize(check);
+        }
+
+        reader.synchronize(check);
+        expect(expected == next);
+        expect(errors == 0);
+        expect(reader.isValid() && writer.isValid());
+    }
+
+    class Writer
+    :
+    public Thread
+    {
+    public:
+        Writer(const String& name, int n)
+        :
+        Thread("Shared Memory Writer"),
+        queue(name, 4096),
+        numRecords(n)
+        {}
+
+        void run() override
+        {
+            for (int i = 0; i < numRecords; ++i)
+            {
+                while (! queue.write(parameterChange, ParameterChange { i, 0.0f }))
+                    yield();
+
+                /* Now and then, give the reader time to go to sleep. */
+                if (i % 1000 == 0)
+                    sleep(1);
+            }
+        }
+
+        SharedMemoryMessageQueue queue;
+        const int numRecords;
+    };
+
+    /** A reader that sleeps whenever the queue is empty must still get
+     every record. */
+    void testWaiting()
+    {
+        beginTest("Waiting");
+        const String name = makeName();
+        const int numRecords = 100000;
+        Writer writer(name, numRecords);
+        SharedMemoryMessageQueue reader(name);
+        expect(reader.isValid());
+        writer.startThread();
+
+        int expected = 0;
+        int errors = 0;
+        const uint32 startTime = Time::getMillisecondCounter();
+
+        while (expected < numRecords && Time::getMillisecondCounter() - startTime < 20000)
+        {
+            reader.waitAndSynchronize([&expected, &errors] (int, const void* data, int)
+            {
+                ParameterChange change;
+                memcpy(&change, data, sizeof(change));
+
+                if (change.index != expected++)
+                    errors++;
+            }, 100);
+        }
+
+        writer.stopThread(1000);
+        expect(expected == numRecords);
+        expect(errors == 0);
+    }
+
+    void runTest() override
+    {
+        testCreateAndOpen();
+        testWrapAround();
+        testWaiting();
+    }
+};
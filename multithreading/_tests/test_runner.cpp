@@ -0,0 +1,139 @@
+/* A console app that runs the tests and benchmarks in this folder.
+
+ Make a console app with the Projucer, add the credland multithreading
+ module, and add just this file: it includes the others itself, and finds
+ JuceHeader.h on the include path the Projucer sets up.
+
+     test_runner                      runs the tests
+     test_runner --benchmarks         runs the benchmarks
+     test_runner --all                runs both
+     test_runner --benchmarks --json results.json
+                                      and writes the figures in
+                                      BenchmarkResults out as JSON
+
+ Returns 1 if anything failed, so it can go in a build script.  Benchmark
+ figures are only worth comparing between release builds on the same,
+ otherwise idle, machine.
+ */
+
+#include "JuceHeader.h"
+
+/* fork() and waitpid() for the shared memory benchmark, and usleep() for
+ the call queue test.  JUCE's headers don't bring them in. */
+#if JUCE_LINUX || JUCE_MAC
+ #include <sys/wait.h>
+ #include <unistd.h>
+#endif
+
+using namespace credland;
+
+#include "benchmark_results.h"
+
+#include "lock_free_call_queue_test.cpp"
+#include "multi_producer_call_queue_test.cpp"
+#include "priority_call_queue_test.cpp"
+#include "queue_set_test.cpp"
+#include "message_thread_call_queue_test.cpp"
+#include "call_queue_coroutines_test.cpp"
+#include "typed_message_queue_test.cpp"
+#include "shared_memory_message_queue_test.cpp"
+#include "work_stealing_thread_pool_test.cpp"
+#include "value_tree_clone_test.cpp"
+
+#include "lock_free_call_queue_benchmark.cpp"
+#include "typed_message_queue_benchmark.cpp"
+#include "shared_memory_message_queue_benchmark.cpp"
+#include "work_stealing_thread_pool_benchmark.cpp"
+#include "regression_benchmark.cpp"
+
+/** Runs the registered tests, or the registered benchmarks, and returns the
+ number of failures. */
+static int runRegistered(bool benchmarks)
+{
+    Array<UnitTest*> tests;
+
+    for (auto* test : UnitTest::getAllTests())
+        if (test->getName().contains("Benchmark") == benchmarks)
+            tests.add(test);
+
+    UnitTestRunner runner;
+    runner.setAssertOnFailure(false);
+    runner.runTests(tests);
+
+    int numFailures = 0;
+
+    for (int i = 0; i < runner.getNumResults(); ++i)
+        numFailures += runner.getResult(i)->failures;
+
+    return numFailures;
+}
+
+/** The benchmarks register themselves with static instances.  The tests are
+ made here instead, so they only exist while they run: some of them start
+ threads in their constructors. */
+static int runTests()
+{
+    CallQueueTest callQueueTest;
+    MultiProducerCallQueueTest multiProducerCallQueueTest;
+    PriorityCallQueueTest priorityCallQueueTest;
+    QueueSetTest queueSetTest;
+    MessageThreadCallQueueTest messageThreadCallQueueTest;
+   #if defined (__cpp_impl_coroutine)
+    CallQueueCoroutinesTest callQueueCoroutinesTest;
+   #endif
+    TypedMessageQueueTest typedMessageQueueTest;
+    SharedMemoryMessageQueueTest sharedMemoryMessageQueueTest;
+    WorkStealingThreadPoolTest workStealingThreadPoolTest;
+   #if JUCE_MODAL_LOOPS_PERMITTED
+    ValueTreeCloneTest valueTreeCloneTest;
+   #endif
+
+    return runRegistered(false);
+}
+
+int main(int argc, char* argv[])
+{
+    const StringArray args(argv + 1, argc - 1);
+    const bool benchmarks = args.contains("--benchmarks") || args.contains("--all");
+    const bool tests = args.contains("--all") || ! benchmarks;
+    const int jsonIndex = args.indexOf("--json");
+    const String jsonPath(jsonIndex >= 0 ? args[jsonIndex + 1] : String());
+
+    /* Makes this the message thread, which GarbageCollectedObject and
+     CriticalThreadValueTree need. */
+    MessageManager::getInstance();
+
+    int numFailures = 0;
+
+    if (tests)
+        numFailures += runTests();
+
+    if (benchmarks)
+        numFailures += runRegistered(true);
+
+    if (jsonIndex >= 0)
+    {
+        const File file(File::getCurrentWorkingDirectory().getChildFile(jsonPath));
+
+        if (jsonPath.isEmpty() || ! BenchmarkResults::getInstance().writeTo(file))
+        {
+            Logger::writeToLog("Couldn't write the benchmark results to " + file.getFullPathName());
+            numFailures++;
+        }
+        else
+        {
+            Logger::writeToLog(String(BenchmarkResults::getInstance().getNumResults())
+                               + " benchmark results written to " + file.getFullPathName());
+        }
+    }
+
+    /* Before the statics go, or the leak detector counts the results as
+     leaks. */
+    BenchmarkResults::getInstance().clear();
+
+    GarbageCollector::deleteInstance();
+    DeletedAtShutdown::deleteAll();
+    MessageManager::deleteInstance();
+
+    return numFailures > 0 ? 1 : 0;
+}
@@ -0,0 +1,215 @@
+/* Benchmarks TypedMessageQueue against LockFreeCallQueue carrying the same
+ parameter changes.
+
+ Like the other benchmarks these log timings rather than pass or fail.  Pin
+ the test runner to two physical cores (taskset) for the threaded figures.
+ */
+
+class TypedMessageQueueBenchmark
+:
+public UnitTest
+{
+public:
+    TypedMessageQueueBenchmark()
+    :
+    UnitTest("Typed Message Queue Benchmarks")
+    {}
+
+    struct SetParam
+    {
+        int index;
+        float value;
+    };
+
+    struct NoteOn
+    {
+        int note;
+        float velocity;
+    };
+
+    typedef TypedMessageQueue<SetParam, NoteOn> Messages;
+
+    /** Stand-in for a plugin's parameter handling. */
+    class ParameterTarget
+    {
+    public:
+        ParameterTarget()
+        {
+            for (auto& v : values)
+                v = 0.0f;
+        }
+
+        void setParam (int index, float value)
+        {
+            values[index & 63] = value;
+            ++count;
+        }
+
+        void noteOn (int note, float velocity)
+        {
+            values[note & 63] += velocity;
+            ++count;
+        }
+
+        /** What the audio thread does with each message it pops. */
+        void handle (const Messages::Message& m)
+        {
+            switch (m.getType())
+            {
+                case Messages::typeOf<SetParam>():
+                    setParam (m.get<SetParam>().index, m.get<SetParam>().value);
+                    break;
+
+                case Messages::typeOf<NoteOn>():
+                    noteOn (m.get<NoteOn>().note, m.get<NoteOn>().velocity);
+                    break;
+            }
+        }
+
+        float values[64];
+        uint64 count = 0;
+    };
+
+    /** Drains a queue as fast as it can, like an audio thread with a tiny
+     buffer. */
+    template <class Drain>
+    class ConsumerThread
+    :
+    public Thread
+    {
+    public:
+        ConsumerThread (Drain d)
+        :
+        Thread ("Benchmark Consumer"),
+        drain (d)
+        {}
+
+        void run() override
+        {
+            while (! threadShouldExit())
+                drain();
+
+            drain();
+        }
+
+    private:
+        Drain drain;
+    };
+
+    template <class Drain>
+    static ConsumerThread<Drain>* makeConsumer (Drain d)
+    {
+        return new ConsumerThread<Drain> (d);
+    }
+
+    /** Single threaded - fill the queue, then drain it - so the figure is
+     the cost of writing, dispatching and reading, without cache traffic
+     between cores.  Half the messages are parameter changes and half note
+     events. */
+    void benchmarkFillAndDrain (int numMessages)
+    {
+        beginTest("Fill and drain, single thread");
+
+        ParameterTarget target;
+        Messages typedQueue (1024);
+        Messages::Message received[64];
+
+        int64 start = Time::getHighResolutionTicks();
+
+        for (int i = 0; i < numMessages;)
+        {
+            while (i < numMessages && ((i & 1) == 0 ? typedQueue.push (SetParam { i, 0.5f })
+                                                    : typedQueue.push (NoteOn { i, 0.5f })))
+                ++i;
+
+            while (const int n = typedQueue.pop (received, 64))
+                for (int j = 0; j < n; ++j)
+                    target.handle (received[j]);
+        }
+
+        const double typedSeconds = Time::highResolutionTicksToSeconds (Time::getHighResolutionTicks() - start);
+        expect(target.count == (uint64) numMessages);
+        target.count = 0;
+
+        /* The same traffic through a LockFreeCallQueue big enough for 1024
+         calls. */
+        LockFreeCallQueue callQueue (1024 * 64);
+        start = Time::getHighResolutionTicks();
+
+        for (int i = 0; i < numMessages;)
+        {
+            while (i < numMessages && ((i & 1) == 0 ? callQueue.callf (&ParameterTarget::setParam, &target, i, 0.5f)
+                                                    : callQueue.callf (&ParameterTarget::noteOn, &target, i, 0.5f)))
+                ++i;
+
+            callQueue.synchronize();
+        }
+
+        const double callSeconds = Time::highResolutionTicksToSeconds (Time::getHighResolutionTicks() - start);
+        expect(target.count == (uint64) numMessages);
+
+        logMessage("TypedMessageQueue: " + String((int64) (numMessages / typedSeconds)) + " messages/sec");
+        logMessage("LockFreeCallQueue: " + String((int64) (numMessages / callSeconds)) + " calls/sec");
+    }
+
+    /** Unpaced, with the consumer on its own thread.  The producer retries
+     whenever the queue is full. */
+    void benchmarkThroughput (int numMessages)
+    {
+        beginTest("Throughput, two threads");
+
+        ParameterTarget typedTarget;
+        Messages typedQueue (1024);
+
+        std::unique_ptr<Thread> consumer (makeConsumer ([&typedQueue, &typedTarget]()
+        {
+            Messages::Message received[64];
+
+            while (const int n = typedQueue.pop (received, 64))
+                for (int j = 0; j < n; ++j)
+                    typedTarget.handle (received[j]);
+        }));
+
+        consumer->startThread();
+        int64 start = Time::getHighResolutionTicks();
+
+        for (int i = 0; i < numMessages; ++i)
+            while (! typedQueue.push (SetParam { i, 0.5f }))
+            {}
+
+        while (! typedQueue.isEmpty())
+        {}
+
+        const double typedSeconds = Time::highResolutionTicksToSeconds (Time::getHighResolutionTicks() - start);
+        consumer->stopThread (500);
+        expect(typedTarget.count == (uint64) numMessages);
+
+        ParameterTarget callTarget;
+        LockFreeCallQueue callQueue (1024 * 64);
+        consumer.reset (makeConsumer ([&callQueue]() { callQueue.synchronize(); }));
+        consumer->startThread();
+        start = Time::getHighResolutionTicks();
+
+        for (int i = 0; i < numMessages; ++i)
+            while (! callQueue.callf (&ParameterTarget::setParam, &callTarget, i, 0.5f))
+            {}
+
+        while (! callQueue.isEmpty())
+        {}
+
+        const double callSeconds = Time::highResolutionTicksToSeconds (Time::getHighResolutionTicks() - start);
+        consumer->stopThread (500);
+        expect(callTarget.count == (uint64) numMessages);
+
+        logMessage("TypedMessageQueue: " + String((int64) (numMessages / typedSeconds)) + " messages/sec");
+        logMessage("LockFreeCallQueue: " + String((int64) (numMessages / callSeconds)) + " calls/sec");
+    }
+
+    void runTest() override
+    {
+        benchmarkFillAndDrain (4000000);
+        benchmarkThroughput (4000000);
+    }
+};
+
+static TypedMessageQueueBenchmark typedMessageQueueBenchmark;
@@ -0,0 +1,185 @@
+
+class TypedMessageQueueTest
+:
+public UnitTest
+{
+public:
+    TypedMessageQueueTest()
+    :
+    UnitTest("Typed Message Queue Tests")
+    {
+    }
+
+    struct SetParam
+    {
+        int index;
+        float value;
+    };
+
+    struct NoteOn
+    {
+        int note;
+        float velocity;
+        int64 timestamp;
+    };
+
+    struct Swap
+    {
+        int* object;
+    };
+
+    typedef TypedMessageQueue<SetParam, NoteOn, Swap> Messages;
+
+    void testTypes()
+    {
+        beginTest("Message Types");
+        Messages queue(16);
+        int object = 0;
+
+        expect(queue.push(SetParam { 3, 0.5f }));
+        expect(queue.push(NoteOn { 60, 1.0f, 1234 }));
+        expect(queue.push(Swap { &object }));
+        expect(queue.getNumMessages() == 3);
+
+        Messages::Message received[8];
+        expect(queue.pop(received, 8) == 3);
+        expect(queue.isEmpty());
+
+        int numChecked = 0;
+
+        for (int i = 0; i < 3; ++i)
+        {
+            switch (received[i].getType())
+            {
+                case Messages::typeOf<SetParam>():
+                    expect(i == 0);
+                    expect(received[i].get<SetParam>().index == 3);
+                    expect(received[i].get<SetParam>().value == 0.5f);
+                    numChecked++;
+                    break;
+
+                case Messages::typeOf<NoteOn>():
+                    expect(i == 1);
+                    expect(received[i].get<NoteOn>().note == 60);
+                    expect(received[i].get<NoteOn>().timestamp == 1234);
+                    numChecked++;
+                    break;
+
+                case Messages::typeOf<Swap>():
+                    expect(i == 2);
+                    expect(received[i].is<Swap>());
+                    expect(received[i].get<Swap>().object == &object);
+                    numChecked++;
+                    break;
+            }
+        }
+
+        expect(numChecked == 3);
+        expect(queue.pop(received, 8) == 0);
+    }
+
+    /** Fills every slot, and drains in small runs that wrap round the end
+     of the ring. */
+    void testFullAndWrapAround()
+    {
+        beginTest("Full And Wrap Around");
+        Messages queue(10);
+        expect(queue.getCapacity() == 16);
+
+        int next = 0;
+        int expected = 0;
+        Messages::Message received[5];
+
+        for (int round = 0; round < 20; ++round)
+        {
+            while (queue.push(SetParam { next, 0.0f }))
+                next++;
+
+            expect(queue.getNumMessages() == 16);
+
+            const int n = queue.pop(received, 5);
+            expect(n == 5);
+
+            for (int i = 0; i < n; ++i)
+                expect(received[i].get<SetParam>().index == expected++);
+        }
+
+        while (const int n = queue.pop(received, 5))
+            for (int i = 0; i < n; ++i)
+                expect(received[i].get<SetParam>().index == expected++);
+
+        expect(expected == next);
+    }
+
+    class Producer
+    :
+    public Thread
+    {
+    public:
+        Producer(Messages& q, int n)
+        :
+        Thread("Typed Message Producer"),
+        queue(q),
+        numMessages(n)
+        {}
+
+        void run() override
+        {
+            for (int i = 0; i < numMessages; ++i)
+            {
+                const bool sent = (i % 2 == 0) ? queue.push(SetParam { i, 0.0f })
+                                               : queue.push(NoteOn { i, 0.0f, 0 });
+
+                if (! sent)
+                {
+                    --i;
+                    yield();
+                }
+            }
+        }
+
+        Messages& queue;
+        const int numMessages;
+    };
+
+    void testThreaded()
+    {
+        beginTest("Threaded");
+        Messages queue(256);
+        const int numMessages = 200000;
+        Producer producer(queue, numMessages);
+        producer.startThread();
+
+        Messages::Message received[64];
+        int expected = 0;
+        int errors = 0;
+
+        while (expected < numMessages)
+        {
+            const int n = queue.pop(received, 64);
+
+            for (int i = 0; i < n; ++i, ++expected)
+            {
+                const Messages::Message& m = received[i];
+                const int index = m.is<SetParam>() ? m.get<SetParam>().index : m.get<NoteOn>().note;
+
+                if (index != expected || m.is<SetParam>() != (expected % 2 == 0))
+                    errors++;
+            }
+
+            if (n == 0)
+                Thread::yield();
+        }
+
+        producer.stopThread(1000);
+        expect(errors == 0);
+        expect(queue.isEmpty());
+    }
+
+    void runTest() override
+    {
+        testTypes();
+        testFullAndWrapAround();
+        testThreaded();
+    }
+};
@@ -0,0 +1,73 @@
+/* Needs runDispatchLoopUntil() to fire CriticalThreadValueTree's timer, and
+ the message thread for the GarbageCollectedObjects. */
+
+#if JUCE_MODAL_LOOPS_PERMITTED
+
+class ValueTreeCloneTest
+:
+public UnitTest
+{
+public:
+    ValueTreeCloneTest()
+    :
+    UnitTest("Value Tree Clone Tests")
+    {
+    }
+
+    /** A burst of changes too big for the queue, then nothing.  The last
+     change must still reach the clone, without any more changes or flushing
+     by hand. */
+    void testSpilledChangesArrive()
+    {
+        beginTest("Spilled changes arrive");
+
+        const Identifier gain("gain");
+        ValueTree source("root");
+        ValueTree node("node");
+        node.setProperty(gain, 0.0, nullptr);
+        source.addChild(node, -1, nullptr);
+
+        LockFreeCallQueue queue(1024);
+        queue.setOverflowPolicy(LockFreeCallQueue::spillToHeap);
+        CriticalThreadValueTree clone(source, queue);
+        queue.synchronize();
+
+        const int numChanges = 200;
+
+        for (int i = 1; i <= numChanges; ++i)
+            node.setProperty(gain, (double) i, nullptr);
+
+        expect(queue.getNumSpilledCalls() > 0);
+
+        /* The critical thread makes room, and the timer fills it. */
+        const uint32 startTime = Time::getMillisecondCounter();
+
+        while (queue.getNumSpilledCalls() > 0 && Time::getMillisecondCounter() - startTime < 5000)
+        {
+            queue.synchronize();
+            MessageManager::getInstance()->runDispatchLoopUntil(20);
+        }
+
+        queue.synchronize();
+
+        expect(queue.getNumSpilledCalls() == 0);
+        expect(queue.getStatistics().callsDropped == 0);
+        expect((double) clone.readonly->getReference().getChild(0).getProperty(gain) == (double) numChanges);
+    }
+
+    void runTest() override
+    {
+        MessageManager* messageManager = MessageManager::getInstanceWithoutCreating();
+
+        if (messageManager == nullptr || ! messageManager->isThisTheMessageThread())
+        {
+            logMessage("Not on the message thread, so skipping the value tree clone tests");
+            return;
+        }
+
+        testSpilledChangesArrive();
+        GarbageCollector::getInstance()->collectGarbage();
+    }
+};
+
+#endif
@@ -0,0 +1,133 @@
+/* Scaling benchmark for WorkStealingThreadPool.
+
+ Runs the same jobs on pools of 1 to getNumCpus() workers and logs the time
+ and the speed-up over a single worker.  Each job also checks its result, so
+ this doubles as a test that every task ran exactly once.
+ */
+
+class WorkStealingThreadPoolBenchmark
+:
+public UnitTest
+{
+public:
+    WorkStealingThreadPoolBenchmark()
+    :
+    UnitTest("Work Stealing Thread Pool Benchmarks")
+    {}
+
+    enum
+    {
+        blockSize = 256,
+        numBlocks = 8192
+    };
+
+    /** Stand-in for an offline render: each task fills one block of a
+     buffer.  Lots of equal sized tasks, all submitted from outside the pool. */
+    class FlatRender
+    {
+    public:
+        FlatRender() : output(numBlocks * blockSize) {}
+
+        void renderBlock(int block)
+        {
+            float* dest = output.data() + block * blockSize;
+            float phase = (float) block;
+
+            for (int i = 0; i < blockSize; ++i)
+            {
+                dest[i] = std::sin(phase) * std::cos(phase * 0.5f);
+                phase += 0.01f;
+            }
+
+            blocksDone.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        std::vector<float> output;
+        std::atomic<int> blocksDone { 0 };
+    };
+
+    /** Divide and conquer: one task is submitted, which splits its range in
+     two and submits both halves until the range is one block.  All the
+     parallelism comes from workers stealing from each other. */
+    class RecursiveRender
+    {
+    public:
+        RecursiveRender(WorkStealingThreadPool& p) : pool(p) {}
+
+        void render(int firstBlock, int numBlocksToRender)
+        {
+            if (numBlocksToRender == 1)
+            {
+                flat.renderBlock(firstBlock);
+                return;
+            }
+
+            const int half = numBlocksToRender / 2;
+            pool.submit(std::bind(&RecursiveRender::render, this, firstBlock, half));
+            pool.submit(std::bind(&RecursiveRender::render, this, firstBlock + half, numBlocksToRender - half));
+        }
+
+        WorkStealingThreadPool& pool;
+        FlatRender flat;
+    };
+
+    double timeFlatRender(int numWorkers)
+    {
+        WorkStealingThreadPool pool(numWorkers);
+        FlatRender job;
+
+        const int64 start = Time::getHighResolutionTicks();
+
+        for (int i = 0; i < numBlocks; ++i)
+        {
+            while (! pool.submit(std::bind(&FlatRender::renderBlock, &job, i)))
+                Thread::yield();
+        }
+
+        pool.waitForAll();
+        const double seconds = Time::highResolutionTicksToSeconds(Time::getHighResolutionTicks() - start);
+
+        expect(job.blocksDone == numBlocks);
+        return seconds;
+    }
+
+    double timeRecursiveRender(int numWorkers)
+    {
+        WorkStealingThreadPool pool(numWorkers);
+        RecursiveRender job(pool);
+
+        const int64 start = Time::getHighResolutionTicks();
+        expect(pool.submit(std::bind(&RecursiveRender::render, &job, 0, (int) numBlocks)));
+        pool.waitForAll();
+        const double seconds = Time::highResolutionTicksToSeconds(Time::getHighResolutionTicks() - start);
+
+        expect(job.flat.blocksDone == numBlocks);
+        return seconds;
+    }
+
+    void runScaling(const String& name, double (WorkStealingThreadPoolBenchmark::*job)(int))
+    {
+        beginTest(name + " scaling");
+
+        double singleWorker = 0.0;
+
+        for (int numWorkers = 1; numWorkers <= SystemStats::getNumCpus(); ++numWorkers)
+        {
+            const double seconds = (this->*job)(numWorkers);
+
+            if (numWorkers == 1)
+                singleWorker = seconds;
+
+            logMessage(String(numWorkers) + " workers: " + String(seconds * 1000.0, 2) + "ms, "
+                       + String(singleWorker / seconds, 2) + "x");
+        }
+    }
+
+    void runTest() override
+    {
+        runScaling("Flat render", &WorkStealingThreadPoolBenchmark::timeFlatRender);
+        runScaling("Recursive render", &WorkStealingThreadPoolBenchmark::timeRecursiveRender);
+    }
+};
+
+static WorkStealingThreadPoolBenchmark workStealingThreadPoolBenchmark;
@@ -0,0 +1,155 @@
+
+class WorkStealingThreadPoolTest
+:
+public UnitTest
+{
+public:
+    WorkStealingThreadPoolTest()
+    :
+    UnitTest("Work Stealing Thread Pool Tests")
+    {
+    }
+
+    /** One counter per task, so a task run twice or not at all shows up. */
+    class RunCounts
+    {
+    public:
+        RunCounts(int numTasks) : counts((size_t) numTasks)
+        {
+            for (auto& c : counts)
+                c.store(0);
+        }
+
+        void run(int task)
+        {
+            counts[(size_t) task].fetch_add(1, std::memory_order_relaxed);
+        }
+
+        /** The number of tasks that didn't run exactly once. */
+        int getNumWrong() const
+        {
+            int numWrong = 0;
+
+            for (auto& c : counts)
+                if (c.load() != 1)
+                    numWrong++;
+
+            return numWrong;
+        }
+
+        std::vector<std::atomic<int>> counts;
+    };
+
+    /** Tasks submitted from outside the pool, retrying whenever a worker's
+     submission queue is full. */
+    void testExactlyOnce(int numWorkers, int tasksPerWorker)
+    {
+        beginTest("Exactly once, " + String(numWorkers) + " workers, "
+                  + String(tasksPerWorker) + " tasks per worker");
+
+        const int numTasks = 100000;
+        RunCounts counts(numTasks);
+
+        {
+            WorkStealingThreadPool pool(numWorkers, tasksPerWorker, 4096);
+
+            for (int i = 0; i < numTasks; ++i)
+                while (! pool.submit([&counts, i] { counts.run(i); }))
+                    Thread::yield();
+
+            pool.waitForAll();
+            expect(pool.getNumPendingTasks() == 0);
+            expect(counts.getNumWrong() == 0);
+
+            /* Again, to check the pool is still working once it's drained. */
+            for (int i = 0; i < numTasks; ++i)
+                while (! pool.submit([&counts, i] { counts.run(i); }))
+                    Thread::yield();
+        }
+
+        /* The destructor waits for everything, so each ran twice. */
+        for (auto& c : counts.counts)
+            c.fetch_sub(1);
+
+        expect(counts.getNumWrong() == 0);
+    }
+
+    /** Splits a range in two and submits both halves from inside the pool,
+     until each piece is one task, so nearly all the work is submitted by
+     workers and spread out by stealing. */
+    class Splitter
+    {
+    public:
+        Splitter(WorkStealingThreadPool& p, RunCounts& c) : pool(p), counts(c) {}
+
+        void split(int first, int num)
+        {
+            if (Thread::getCurrentThread() == nullptr)
+                numOffPool++;
+
+            if (num == 1)
+            {
+                counts.run(first);
+                return;
+            }
+
+            const int half = num / 2;
+            pool.submit(std::bind(&Splitter::split, this, first, half));
+            pool.submit(std::bind(&Splitter::split, this, first + half, num - half));
+        }
+
+        WorkStealingThreadPool& pool;
+        RunCounts& counts;
+        std::atomic<int> numOffPool { 0 };
+    };
+
+    void testSubmitFromWorker()
+    {
+        beginTest("Submit from inside a worker");
+
+        const int numTasks = 65536;
+        RunCounts counts(numTasks);
+        WorkStealingThreadPool pool(4);
+        Splitter splitter(pool, counts);
+
+        expect(pool.submit(std::bind(&Splitter::split, &splitter, 0, numTasks)));
+        pool.waitForAll();
+
+        expect(counts.getNumWrong() == 0);
+        expect(splitter.numOffPool == 0);
+    }
+
+    /** A deque of two slots.  Submitting from inside a task can't fail, so
+     everything that doesn't fit has to run straight away instead. */
+    void testFullDeque()
+    {
+        beginTest("Full deque");
+
+        const int numTasks = 10000;
+        RunCounts counts(numTasks);
+        WorkStealingThreadPool pool(1, 2);
+        std::atomic<int> numSubmitted(0);
+
+        expect(pool.submit([&pool, &counts, &numSubmitted, numTasks]
+        {
+            for (int i = 0; i < numTasks; ++i)
+                if (pool.submit([&counts, i] { counts.run(i); }))
+                    numSubmitted++;
+        }));
+
+        pool.waitForAll();
+
+        expect(numSubmitted == numTasks);
+        expect(counts.getNumWrong() == 0);
+        expect(pool.getNumPendingTasks() == 0);
+    }
+
+    void runTest() override
+    {
+        testExactlyOnce(1, 1024);
+        testExactlyOnce(4, 1024);
+        testExactlyOnce(4, 2);
+        testSubmitFromWorker();
+        testFullDeque();
+    }
+};
@@ -28,10 +28,26 @@ SOFTWARE.
 #include "AppConfig.h"
 #include "multithreading.h"
 
+#if JUCE_WINDOWS
+ #include <windows.h>
+#else
+ #include <sys/mman.h>
+ #include <sys/stat.h>
+ #include <fcntl.h>
+ #include <unistd.h>
+#endif
+
+#if JUCE_LINUX
+ #include <linux/futex.h>
+ #include <sys/syscall.h>
+#endif
+
 
 namespace credland {
 
 #include "source/garbage_collected_object.cpp"
+#include "source/realtime_memory.cpp"
+#include "source/shared_memory_message_queue.cpp"
 
 }
 
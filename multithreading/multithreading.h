@@ -28,12 +28,30 @@ SOFTWARE.
 #include <modules/juce_core/juce_core.h>
 #include <modules/juce_data_structures/juce_data_structures.h>
 #include <list>
+#include <atomic>
+#include <type_traits>
+
+#if defined (__cpp_impl_coroutine)
+ #include <coroutine>
+#endif
 
 namespace credland {
     using namespace juce; 
 
 #include "source/garbage_collected_object.h"
+#include "source/realtime_memory.h"
+#include "source/call_queue_base.h"
+#include "source/call_queue_statistics.h"
+#include "source/call_result.h"
 #include "source/nonblocking_call_queue.h"
+#include "source/queue_set.h"
+#include "source/message_thread_call_queue.h"
+#include "source/call_queue_coroutines.h"
+#include "source/multi_producer_call_queue.h"
+#include "source/priority_call_queue.h"
+#include "source/typed_message_queue.h"
+#include "source/shared_memory_message_queue.h"
+#include "source/work_stealing_thread_pool.h"
 #include "source/value_tree_clone.h"
 
 }
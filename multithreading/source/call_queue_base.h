@@ -0,0 +1,252 @@
+/*
+  ==============================================================================
+
+    call_queue_base.h
+    Created: 17 Oct 2026
+
+  ==============================================================================
+*/
+
+#ifndef CALL_QUEUE_BASE_H_INCLUDED
+#define CALL_QUEUE_BASE_H_INCLUDED
+
+
+/** @internal
+ * @brief Cache line aligned storage for objects made with new.
+ *
+ * Classes with cache line aligned members (PaddedAtomic and friends) derive
+ * from this.  Before C++17 new ignores any alignment bigger than
+ * alignof (std::max_align_t), so without it the padding meant to keep the
+ * members on their own cache lines can straddle two.
+ */
+class CacheLineAlignedObject
+{
+public:
+    static void* operator new (size_t size)         { return allocate (size); }
+    static void* operator new[] (size_t size)       { return allocate (size); }
+    static void* operator new (size_t, void* place) { return place; }
+    static void operator delete (void* p)           { release (p); }
+    static void operator delete[] (void* p)         { release (p); }
+    static void operator delete (void*, void*)      {}
+
+private:
+    enum { alignment = 64 };    /* CallQueueBase::cacheLineSize */
+
+    /* Like the rings, allocate a little extra and skip to the first aligned
+     address.  The pointer to free goes just in front of it. */
+    static void* allocate (size_t size)
+    {
+        char* raw = static_cast<char*> (::operator new (size + alignment + sizeof (void*)));
+        char* p = raw + sizeof (void*);
+        p += (alignment - (reinterpret_cast<size_t> (p) & (alignment - 1))) & (alignment - 1);
+        reinterpret_cast<void**> (p)[-1] = raw;
+        return p;
+    }
+
+    static void release (void* p)
+    {
+        if (p != nullptr)
+            ::operator delete (static_cast<void**> (p)[-1]);
+    }
+};
+
+/** @internal
+ * @brief The type-erased call storage shared by the call queues.
+ *
+ * LockFreeCallQueue and MultiProducerCallQueue inherit this privately.  You
+ * shouldn't have to use it directly.
+ */
+class CallQueueBase
+{
+protected:
+    /* Avoid a vtable and two separate virtual function dispatches (operator() and destructor) by putting
+     everything into a single function and implementing our own virtual function call. */
+
+    /**
+     Type for pointer to a function that executes work, calls the destructor for the and
+     returns size of concrete instance.
+     */
+    typedef int (*WorkExecAndDestructFunctionPtr) (void* workItemStorage);
+
+    class Work
+    {
+        // NOTE: no vtable.
+    public:
+        Work (WorkExecAndDestructFunctionPtr f) :
+            execAndDestructFn (f)
+        { }
+        WorkExecAndDestructFunctionPtr execAndDestructFn;
+    };
+
+    /** WorkItem template - extends Work for each type of Functor */
+    template <class Functor>
+    struct WorkItem : public Work
+    {
+        /* A trivially copyable functor is copied in with a plain memcpy by its
+         copy constructor, so the only thing left to specialise is the destructor. */
+        explicit WorkItem (Functor const& fun) :
+            Work (getExecFunction (std::is_trivially_destructible<Functor>())),
+            myCall (fun)
+        {}
+
+        explicit WorkItem (Functor&& fun) :
+            Work (getExecFunction (std::is_trivially_destructible<Functor>())),
+            myCall (std::move (fun))
+        {}
+
+    private:
+        static WorkExecAndDestructFunctionPtr getExecFunction (std::false_type)
+        {
+            return &WorkItem::myExecAndDestruct;
+        }
+
+        static WorkExecAndDestructFunctionPtr getExecFunction (std::true_type)
+        {
+            return &WorkItem::myExec;
+        }
+
+        static int myExecAndDestruct (void* workItemStorage)
+        {
+            /* cast to *concrete* work item pointer of this template type */
+            WorkItem* that = reinterpret_cast<WorkItem*> (workItemStorage);
+            that->myCall();
+            that->~WorkItem(); // invoke concrete dtor (destructs functor)
+            return static_cast<int>(sizeof (WorkItem));
+        }
+
+        /* For functors with nothing to destroy - a function pointer and a few
+         values, say.  Skipping the destructor call outright means debug builds,
+         which don't optimise away the empty call, don't pay for it either. */
+        static int myExec (void* workItemStorage)
+        {
+            reinterpret_cast<WorkItem*> (workItemStorage)->myCall();
+            return static_cast<int>(sizeof (WorkItem));
+        }
+
+        Functor myCall;
+    };
+
+    /** The arguments for a MemberCall.  Unlike std::tuple, which std::bind
+     uses, this is trivially copyable and destructible whenever the arguments
+     are, so it gets the WorkItem fast path. */
+    template <class... Args>
+    struct ArgPack;
+
+    template <class First, class... Rest>
+    struct ArgPack<First, Rest...>
+    {
+        ArgPack (First const& f, Rest const&... r) : first (f), rest (r...) {}
+
+        template <class Object, class Method, class... Done>
+        void call (Object* object, Method method, Done&... done)
+        {
+            rest.call (object, method, done..., first);
+        }
+
+        First first;
+        ArgPack<Rest...> rest;
+    };
+
+    /* The empty pack, which ends the recursion. */
+    template <class... Args>
+    struct ArgPack
+    {
+        template <class Object, class Method, class... Done>
+        void call (Object* object, Method method, Done&... done)
+        {
+            (object->*method) (done...);
+        }
+    };
+
+    /** Compact record for callf (&Object::method, object, args...), the
+     queue's equivalent of std::bind (&Object::method, object, args...). */
+    template <class Method, class Object, class... Args>
+    struct MemberCall
+    {
+        MemberCall (Method m, Object* o, Args const&... a) : method (m), object (o), args (a...) {}
+
+        void operator()()
+        {
+            args.call (object, method);
+        }
+
+        Method method;
+        Object* object;
+        ArgPack<Args...> args;
+    };
+
+    /** Fills the gap in front of an over-aligned WorkItem.  Runs nothing, and
+     reports the size of the gap so the reader steps straight over it. */
+    struct SkipItem : public Work
+    {
+        explicit SkipItem (int gapSize) :
+            Work (&SkipItem::skip),
+            size (gapSize)
+        {}
+
+        static int skip (void* workItemStorage)
+        {
+            return reinterpret_cast<SkipItem*> (workItemStorage)->size;
+        }
+
+    private:
+        int size;
+    };
+
+    static bool isSkipItem (const Work* w)
+    {
+        return w->execAndDestructFn == &SkipItem::skip;
+    }
+
+    /* For clarity (maybe) what's happening here is:
+     1  There are instances of the templated class WorkItem for each type of Functor, and hence
+        multiple versions of myExecAndDestruct.
+     2  When the WorkItem is created the Work::execAndDestructFn pointer is set to
+        point to the appropriate instance of myExecAndDestruct - the pointer is passed
+        to the Work superclass constructor by the WorkItem<Functor> class.
+
+     To call we:
+     -  Get the data from the fifo.
+     -  Cast it to be a Work.
+     -  Call the appropriate instance of myExecAndDestruct
+        via the execAndDestructFn pointer.
+    */
+
+    /* Used to avoid false sharing and to give correct alignment to embedded structs. */
+    static const int cacheLineSize = 64;
+
+    static int roundUpToCacheLineBoundary (int x)
+    {
+        return (x + cacheLineSize - 1) & ~(cacheLineSize - 1);
+    }
+
+    /* Number of bytes to skip from p to reach the next multiple of alignment. */
+    static int getPaddingForAlignment (const char* p, size_t alignment)
+    {
+        const size_t misalignment = reinterpret_cast<size_t> (p) & (alignment - 1);
+        return misalignment == 0 ? 0 : static_cast<int> (alignment - misalignment);
+    }
+
+    /* An atomic with a cache line to itself.  Positions that one thread writes
+     and another polls must not share a line with anything else, or every write
+     invalidates the line the other thread is reading. */
+    template <class Type>
+    struct alignas (cacheLineSize) PaddedAtomic
+    {
+        PaddedAtomic() : value (Type()) {}
+        std::atomic<Type> value;
+    };
+
+    /** A plain value with a cache line to itself, for state only one thread
+     touches that mustn't share a line with anything the other thread does. */
+    template <class Type>
+    struct alignas (cacheLineSize) PaddedValue
+    {
+        PaddedValue() : value (Type()) {}
+        Type value;
+    };
+};
+
+
+
+#endif  // CALL_QUEUE_BASE_H_INCLUDED
@@ -0,0 +1,337 @@
+/*
+  ==============================================================================
+
+    call_queue_coroutines.h
+    Created: 17 Oct 2026
+
+  ==============================================================================
+*/
+
+#ifndef CALL_QUEUE_COROUTINES_H_INCLUDED
+#define CALL_QUEUE_COROUTINES_H_INCLUDED
+
+#if defined (__cpp_impl_coroutine)
+
+/**
+ * @brief A fixed set of equal sized blocks for coroutine frames, so starting
+ * and finishing a CallQueueTask never touches the system allocator.
+ *
+ * A CallQueueTask's frame is freed on whichever thread the coroutine
+ * finishes on, which may be the audio thread, so the pool's free list is
+ * lock-free.  Any thread may allocate or free.
+ *
+ * Size it for the most coroutines you'll have in flight at once, and the
+ * biggest frame.  Frame sizes are up to the compiler: a debug build's are
+ * bigger, and allocate() asserts when a frame doesn't fit.
+ */
+class CoroutineFramePool
+{
+public:
+    /**
+     * @param numFrames - the most frames in use at once.
+     * @param maxFrameSize - the largest frame, in bytes.
+     */
+    CoroutineFramePool (int numFrames, int maxFrameSize)
+        :
+        blockSize (roundUpToHeaderSize (static_cast<size_t> (maxFrameSize)) + headerSize),
+        numBlocks (numFrames),
+        rawdata (new char[blockSize * static_cast<size_t> (numFrames) + headerSize]),
+        nextFree (new std::atomic<int32>[static_cast<size_t> (numFrames)]),
+        numInUse (0)
+    {
+        jassert (numFrames > 0);
+        data = rawdata.get() + getPaddingForHeader (rawdata.get());
+
+        for (int i = 0; i < numFrames; ++i)
+            nextFree[i].store (i + 1 < numFrames ? i + 1 : endOfList, std::memory_order_relaxed);
+
+        freeList.store (makeHead (0, 0), std::memory_order_release);
+    }
+
+    ~CoroutineFramePool()
+    {
+        /* Frames still in use will be freed into a pool that's gone. */
+        jassert (numInUse.load() == 0);
+    }
+
+    /** @returns a block of at least numBytes, or nullptr if the pool is
+     * empty or numBytes is more than the pool was made for. */
+    void* allocate (size_t numBytes) noexcept
+    {
+        if (numBytes + headerSize > blockSize)
+        {
+            jassertfalse;   // make the pool's maxFrameSize bigger
+            return nullptr;
+        }
+
+        uint64 head = freeList.load (std::memory_order_acquire);
+
+        for (;;)
+        {
+            const int32 index = getIndex (head);
+
+            if (index == endOfList)
+                return nullptr;
+
+            /* The tag changes on every pop, so a block freed and reused
+             between the load and the exchange can't fool us. */
+            const uint64 next = makeHead (nextFree[index].load (std::memory_order_relaxed), getTag (head) + 1);
+
+            if (freeList.compare_exchange_weak (head, next, std::memory_order_acquire, std::memory_order_acquire))
+            {
+                numInUse.fetch_add (1, std::memory_order_relaxed);
+
+                char* block = data + blockSize * static_cast<size_t> (index);
+                *reinterpret_cast<CoroutineFramePool**> (block) = this;
+                return block + headerSize;
+            }
+        }
+    }
+
+    /** @brief Return a block from allocate() to whichever pool it came from. */
+    static void deallocate (void* p) noexcept
+    {
+        if (p == nullptr)
+            return;
+
+        char* block = static_cast<char*> (p) - headerSize;
+        CoroutineFramePool* pool = *reinterpret_cast<CoroutineFramePool**> (block);
+        pool->release (static_cast<int32> ((block - pool->data) / static_cast<std::ptrdiff_t> (pool->blockSize)));
+    }
+
+    int getNumFramesInUse() const
+    {
+        return numInUse.load (std::memory_order_relaxed);
+    }
+
+    /** @brief Keep the pool in RAM.  @see LockFreeCallQueue::lockMemory() */
+    bool lockMemory()
+    {
+        RealtimeMemoryLock::prefault (data, blockSize * static_cast<size_t> (numBlocks));
+        return memoryLock.lock (data, blockSize * static_cast<size_t> (numBlocks));
+    }
+
+private:
+    /* Each block starts with a pointer back to its pool, padded so the frame
+     after it is aligned for anything. */
+    static constexpr size_t headerSize = alignof (std::max_align_t);
+    static constexpr int32 endOfList = -1;
+
+    static size_t roundUpToHeaderSize (size_t x)
+    {
+        return (x + headerSize - 1) & ~(headerSize - 1);
+    }
+
+    static size_t getPaddingForHeader (const char* p)
+    {
+        return roundUpToHeaderSize (reinterpret_cast<size_t> (p)) - reinterpret_cast<size_t> (p);
+    }
+
+    /* The free list head packs the first free block's index with a tag. */
+    static uint64 makeHead (int32 index, uint32 tag)
+    {
+        return (static_cast<uint64> (tag) << 32) | static_cast<uint32> (index);
+    }
+
+    static int32 getIndex (uint64 head)
+    {
+        return static_cast<int32> (static_cast<uint32> (head));
+    }
+
+    static uint32 getTag (uint64 head)
+    {
+        return static_cast<uint32> (head >> 32);
+    }
+
+    void release (int32 index) noexcept
+    {
+        uint64 head = freeList.load (std::memory_order_relaxed);
+
+        for (;;)
+        {
+            nextFree[index].store (getIndex (head), std::memory_order_relaxed);
+
+            if (freeList.compare_exchange_weak (head, makeHead (index, getTag (head)),
+                                                std::memory_order_release, std::memory_order_relaxed))
+                break;
+        }
+
+        numInUse.fetch_sub (1, std::memory_order_relaxed);
+    }
+
+    const size_t blockSize;
+    const int numBlocks;
+    std::unique_ptr<char[]> rawdata;
+    char* data;
+    std::unique_ptr<std::atomic<int32>[]> nextFree;
+    std::atomic<uint64> freeList;
+    std::atomic<int> numInUse;
+    RealtimeMemoryLock memoryLock;
+
+    JUCE_DECLARE_NON_COPYABLE (CoroutineFramePool)
+};
+
+/**
+ * @brief The return type for a coroutine that hops between threads through
+ * call queues.
+ *
+ * Work that ping-pongs between threads, like preparing an object on the
+ * message thread, swapping it in on the audio thread, then freeing the old
+ * one back on the message thread, can be written as one function instead of
+ * a chain of callbacks:
+ *
+ * @code
+ * CallQueueTask replaceSample (CoroutineFramePool&, Voice& voice, File file)
+ * {
+ *     auto* sample = new Sample (file);                  // message thread
+ *
+ *     co_await onCriticalThread (toAudio);
+ *     std::swap (voice.sample, sample);                  // audio thread
+ *
+ *     co_await onMessageThread (toMessageThread);
+ *     delete sample;                                     // message thread
+ * }
+ *
+ * replaceSample (framePool, voice, file);
+ * @endcode
+ *
+ * The coroutine starts straight away on the calling thread and runs until
+ * its first co_await.  Nobody waits for it to finish: its frame is freed
+ * when it returns, on whichever thread it's running on then.
+ *
+ *   Watch out for:
+ *   - The first parameter must be a CoroutineFramePool, which the frame is
+ *   allocated from.  For a member function, it's the first parameter after
+ *   the object.  If the pool is empty the coroutine doesn't run at all; check
+ *   wasStarted() if that matters.
+ *   - A hop is a call made through a queue, so it follows the queue's rules.
+ *   Only hop through a queue from the thread that is its producer.
+ *   - A hop fails if the queue is full, and the coroutine carries on where it
+ *   was.  The co_await returns false when that happens.
+ *   - Exceptions can't escape a coroutine that nobody waits for, so one
+ *   that isn't caught inside it terminates the program.
+ *   - Locals live in the frame, and the frame is freed by the thread it
+ *   finishes on.  Anything with a non-trivial destructor still in scope at
+ *   the end will be destroyed on that thread.
+ */
+class CallQueueTask
+{
+public:
+    bool wasStarted() const
+    {
+        return started;
+    }
+
+    struct promise_type
+    {
+        CallQueueTask get_return_object() noexcept
+        {
+            return CallQueueTask (true);
+        }
+
+        static CallQueueTask get_return_object_on_allocation_failure() noexcept
+        {
+            return CallQueueTask (false);
+        }
+
+        std::suspend_never initial_suspend() const noexcept
+        {
+            return {};
+        }
+
+        /* Don't suspend at the end, so the frame frees itself. */
+        std::suspend_never final_suspend() const noexcept
+        {
+            return {};
+        }
+
+        void return_void() const noexcept {}
+
+        void unhandled_exception() const noexcept
+        {
+            std::terminate();
+        }
+
+        template <class... Args>
+        static void* operator new (size_t size, CoroutineFramePool& pool, Args&...) noexcept
+        {
+            return pool.allocate (size);
+        }
+
+        /* Member function coroutines are passed the object first. */
+        template <class Object, class... Args>
+        static void* operator new (size_t size, Object&, CoroutineFramePool& pool, Args&...) noexcept
+        {
+            return pool.allocate (size);
+        }
+
+        static void operator delete (void* p) noexcept
+        {
+            CoroutineFramePool::deallocate (p);
+        }
+    };
+
+private:
+    explicit CallQueueTask (bool wasStarted) : started (wasStarted) {}
+
+    bool started;
+};
+
+/**
+ * @brief An awaitable that moves a coroutine onto the consumer thread of a
+ * call queue.  @see onCriticalThread(), onMessageThread()
+ */
+template <class Queue>
+class ResumeOnQueue
+{
+public:
+    explicit ResumeOnQueue (Queue& q) : queue (q), hopped (false) {}
+
+    bool await_ready() const noexcept
+    {
+        return false;
+    }
+
+    bool await_suspend (std::coroutine_handle<> coroutine)
+    {
+        /* Once the call is in the queue the coroutine may already be running,
+         or finished, on the other thread, so set hopped first and don't touch
+         this afterwards unless the call failed. */
+        hopped = true;
+
+        if (queue.callf ([coroutine]() { coroutine.resume(); }))
+            return true;
+
+        hopped = false;
+        return false;
+    }
+
+    /** @returns true if the coroutine is now on the queue's consumer
+     * thread, false if the queue was full and it's still where it was. */
+    bool await_resume() const noexcept
+    {
+        return hopped;
+    }
+
+private:
+    Queue& queue;
+    bool hopped;
+};
+
+/** @brief co_await this to continue on the thread that synchronizes queue,
+ * normally the audio thread.  @see CallQueueTask */
+inline ResumeOnQueue<LockFreeCallQueue> onCriticalThread (LockFreeCallQueue& queue)
+{
+    return ResumeOnQueue<LockFreeCallQueue> (queue);
+}
+
+/** @brief co_await this on the audio thread to continue on the message
+ * thread.  @see CallQueueTask, MessageThreadCallQueue */
+inline ResumeOnQueue<MessageThreadCallQueue> onMessageThread (MessageThreadCallQueue& queue)
+{
+    return ResumeOnQueue<MessageThreadCallQueue> (queue);
+}
+
+#endif  // __cpp_impl_coroutine
+
+#endif  // CALL_QUEUE_COROUTINES_H_INCLUDED
@@ -0,0 +1,98 @@
+/*
+  ==============================================================================
+
+    call_queue_statistics.h
+    Created: 17 Oct 2026
+
+  ==============================================================================
+*/
+
+#ifndef CALL_QUEUE_STATISTICS_H_INCLUDED
+#define CALL_QUEUE_STATISTICS_H_INCLUDED
+
+
+/**
+ * @brief A snapshot of a LockFreeCallQueue's counters, for sizing queues from
+ * real sessions.  @see LockFreeCallQueue::getStatistics()
+ */
+struct CallQueueStatistics
+{
+    uint32 callsMade;       /**< calls successfully added with callf(). */
+    uint32 callsExecuted;   /**< calls run by synchronize(). */
+    uint32 callsDropped;    /**< calls refused because the queue was full. */
+    uint32 callsSpilled;    /**< calls held on the heap because the queue was full.
+                                 @see LockFreeCallQueue::spillToHeap */
+    int peakBytesUsed;      /**< the most the queue has held, as seen by the
+                                 consumer each time it catches up. */
+    int bufferSize;         /**< the queue's size, for comparison with peakBytesUsed. */
+};
+
+/**
+ * @brief Counts how long calls spent in a LockFreeCallQueue, from callf() to
+ * the moment synchronize() started running them.
+ *
+ * The buckets double in width: bucket 0 counts calls that waited under a
+ * microsecond, bucket n those under 2^n microseconds, and the last bucket
+ * everything slower.  Only the consumer thread writes the counts, one
+ * relaxed store per call, so reading them from the message thread costs the
+ * realtime side nothing.  The counts from a running queue are a snapshot and
+ * may be one or two calls apart from each other.
+ *
+ * @see LockFreeCallQueue::setMeasureLatency()
+ */
+class CallQueueLatencyHistogram
+{
+public:
+    enum { numBuckets = 24 };
+
+    CallQueueLatencyHistogram()
+    {
+        for (auto& c : counts)
+            c.store (0, std::memory_order_relaxed);
+    }
+
+    /** Consumer thread only. */
+    void add (int64 ticks)
+    {
+        const double microseconds = Time::highResolutionTicksToSeconds (ticks) * 1.0e6;
+        int bucket = 0;
+
+        while (bucket < numBuckets - 1 && microseconds >= getBucketLimitMicroseconds (bucket))
+            ++bucket;
+
+        counts[bucket].store (counts[bucket].load (std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+
+    /** The number of calls that fell in a bucket. */
+    uint32 getCount (int bucket) const
+    {
+        jassert (isPositiveAndBelow (bucket, (int) numBuckets));
+        return counts[bucket].load (std::memory_order_relaxed);
+    }
+
+    /** Calls in this bucket waited less than this.  The last bucket has no
+     upper limit. */
+    static double getBucketLimitMicroseconds (int bucket)
+    {
+        return (double) (1 << bucket);
+    }
+
+    uint32 getTotalCount() const
+    {
+        uint32 total = 0;
+
+        for (auto& c : counts)
+            total += c.load (std::memory_order_relaxed);
+
+        return total;
+    }
+
+private:
+    std::atomic<uint32> counts[numBuckets];
+
+    JUCE_DECLARE_NON_COPYABLE (CallQueueLatencyHistogram)
+};
+
+
+
+#endif  // CALL_QUEUE_STATISTICS_H_INCLUDED
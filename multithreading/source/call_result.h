@@ -0,0 +1,152 @@
+/*
+  ==============================================================================
+
+    call_result.h
+    Created: 17 Oct 2026
+
+  ==============================================================================
+*/
+
+#ifndef CALL_RESULT_H_INCLUDED
+#define CALL_RESULT_H_INCLUDED
+
+
+/**
+ * @brief Somewhere for a call made with LockFreeCallQueue::callfWithResult()
+ * to leave its return value.
+ *
+ * Use it for round trips, like asking the audio thread for its current voice
+ * count, without a second queue going back the other way.  The producer
+ * owns the CallResult and keeps it, usually as a member, for as long as a
+ * call is outstanding.  The consumer writes the value straight into it and
+ * then sets a flag, so neither side allocates or takes a lock.  The producer
+ * can poll isReady() from a timer or block in waitForResult().
+ *
+ * @code
+ * CallResult<int> voiceCount;
+ *
+ * void timerCallback() override
+ * {
+ *     if (voiceCount.isReady())
+ *         label.setText (String (voiceCount.get()), dontSendNotification);
+ *
+ *     if (! voiceCount.isPending())
+ *         queue.callfWithResult (voiceCount, std::bind (&Synth::getNumActiveVoices, &synth));
+ * }
+ * @endcode
+ *
+ *   Watch out for:
+ *   - The value is copy constructed on the consumer thread, so pick a type
+ *   that doesn't allocate when copied: a number, or a struct of numbers.
+ *   - If the queue is stopped before the call runs, the result stays pending
+ *   for ever.
+ *   - Destroying a CallResult with a call still pending will leave the
+ *   consumer writing to freed memory.
+ */
+template <class ResultType>
+class CallResult
+{
+public:
+    CallResult() : state (idle) {}
+
+    ~CallResult()
+    {
+        jassert (! isPending());
+        reset();
+    }
+
+    /** @brief True once the call has run and the value can be read. */
+    bool isReady() const
+    {
+        return state.load (std::memory_order_acquire) == ready;
+    }
+
+    /** @brief True from callfWithResult() until the call has run. */
+    bool isPending() const
+    {
+        return state.load (std::memory_order_acquire) == pending;
+    }
+
+    /** @brief The value the call returned.  Only valid when isReady(). */
+    const ResultType& get() const
+    {
+        jassert (isReady());
+        return *reinterpret_cast<const ResultType*> (&storage);
+    }
+
+    /** @brief Wait for the call to run.
+     *
+     * Yields for a while then polls every millisecond, so the consumer never
+     * has to signal anything.  Not for use on the audio thread.
+     *
+     * @returns true if the result is ready, false if it timed out.
+     */
+    bool waitForResult (int timeOutMilliseconds = -1)
+    {
+        const uint32 start = Time::getMillisecondCounter();
+
+        for (int i = 0; ! isReady(); ++i)
+        {
+            if (timeOutMilliseconds >= 0
+                && Time::getMillisecondCounter() - start >= (uint32) timeOutMilliseconds)
+                return false;
+
+            if (i < yieldCount)
+                Thread::yield();
+            else
+                Thread::sleep (1);
+        }
+
+        return true;
+    }
+
+    /** @brief Throw away any value so the CallResult can be used again.
+     *
+     * Producer thread only, and not while a call is pending.
+     * callfWithResult() does this for you.
+     */
+    void reset()
+    {
+        jassert (! isPending());
+
+        if (state.load (std::memory_order_acquire) == ready)
+            reinterpret_cast<ResultType*> (&storage)->~ResultType();
+
+        state.store (idle, std::memory_order_relaxed);
+    }
+
+private:
+    friend class LockFreeCallQueue;
+
+    /* Called by the queue on the producer thread, before posting the call. */
+    void setPending()
+    {
+        reset();
+        state.store (pending, std::memory_order_relaxed);
+    }
+
+    /* Called by the queue if the call couldn't be posted. */
+    void cancelPending()
+    {
+        state.store (idle, std::memory_order_relaxed);
+    }
+
+    /* Called by the queue on the consumer thread. */
+    void setResult (const ResultType& value)
+    {
+        new (&storage) ResultType (value);
+        state.store (ready, std::memory_order_release);
+    }
+
+    enum { idle, pending, ready };
+    static const int yieldCount = 100;
+
+    std::atomic<int> state;
+    typename std::aligned_storage<sizeof (ResultType), alignof (ResultType)>::type storage;
+
+    JUCE_DECLARE_NON_COPYABLE (CallResult)
+};
+
+
+
+#endif  // CALL_RESULT_H_INCLUDED
@@ -37,7 +37,7 @@ public:
          need to do a lot of clearing up. */
         int count = 100;
 
-        while (data.size() > 0 && count--) timerCallback();
+        while (data.size() > 0 && count--) collectGarbage();
 
         jassert (data.size() == 0);
     }
@@ -47,6 +47,36 @@ public:
     {
         return (std::find (data.begin(), data.end(), o) != data.end());
     }
+
+    /** Delete every object nothing else holds a reference to now, rather
+     than waiting for the timer.  Message thread only.  Handy before shutting
+     down, and for measuring what each timer callback costs.
+
+     @returns the number of objects deleted. */
+    int collectGarbage()
+    {
+        const size_t sizeBefore = data.size();
+
+        data.remove_if ([] (ReferenceCountedObject * o)
+        {
+            if (o->getReferenceCount() == 1)
+            {
+                o->decReferenceCount(); /* Will delete it too! */
+                return true;
+            }
+
+            return false;
+        });
+
+        return static_cast<int> (sizeBefore - data.size());
+    }
+
+    /** The number of objects being looked after, whether or not they're
+     ready to delete. */
+    int getNumObjects() const
+    {
+        return static_cast<int> (data.size());
+    }
 private:
     static void add (ReferenceCountedObject* o)
     {
@@ -61,16 +91,7 @@ private:
 
     void timerCallback()
     {
-        data.remove_if ([] (ReferenceCountedObject * o)
-        {
-            if (o->getReferenceCount() == 1)
-            {
-                o->decReferenceCount(); /* Will delete it too! */
-                return true;
-            }
-
-            return false;
-        });
+        collectGarbage();
     }
     std::list<ReferenceCountedObject*> data;
     friend class GarbageCollectedObject;
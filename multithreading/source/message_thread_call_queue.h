@@ -0,0 +1,181 @@
+/*
+  ==============================================================================
+
+    message_thread_call_queue.h
+    Created: 17 Oct 2026
+
+  ==============================================================================
+*/
+
+#ifndef MESSAGE_THREAD_CALL_QUEUE_H_INCLUDED
+#define MESSAGE_THREAD_CALL_QUEUE_H_INCLUDED
+
+
+/**
+ * @brief A call queue for sending calls back from the audio thread to the
+ * message thread, without a Timer polling it.
+ *
+ * Use it for meter levels, "voice stolen" events, and objects handed back
+ * to be deleted.  The audio thread makes calls with callf(), and they're
+ * run on the message thread soon after, by a MessageManager callback.
+ *
+ * Posting a message for every call would flood the message queue, and
+ * posting a message can take a lock.  So the audio thread posts at most one
+ * message per drain: the first callf() after the message thread has drained
+ * the queue posts one, and every other callf() just finds the wakeup flag
+ * already set, which costs it a single atomic exchange.
+ *
+ * So callf() is not wait-free.  Re-arming the wakeup flag is, but the first
+ * callf() after each drain also posts the message, and that can wait on a
+ * lock in the OS's message queue.  Every other callf() is wait-free.
+ *
+ * @code
+ * MessageThreadCallQueue toGui (16384);
+ *
+ * // audio thread
+ * toGui.callf (&MeterComponent::setLevel, &meter, rms);
+ * @endcode
+ *
+ *   Watch out for:
+ *   - The one message per drain is posted with AsyncUpdater, which goes
+ *   through the OS's message queue and may briefly take a lock there.  It
+ *   happens once per message thread cycle at most, rather than once per
+ *   call, but a thread that can never block must not call callf().  Use a
+ *   LockFreeCallQueue from there instead, and synchronize() it from a Timer.
+ *   - As with LockFreeCallQueue, only one thread may make calls, usually
+ *   the audio thread.  Calls are dropped, not spilled, when the queue is full, so size it for a stalled
+ *   message thread.
+ *   - Objects the calls refer to must outlive them.  Call stop() and stop
+ *   the audio thread before deleting them.
+ */
+class MessageThreadCallQueue
+    : public CacheLineAlignedObject,
+      private AsyncUpdater,
+      private CallQueueBase
+{
+public:
+    /** @param bufferSize - size of the queue in bytes. */
+    explicit MessageThreadCallQueue (int bufferSize)
+        :
+        queue (bufferSize),
+        maxDrainTime (0)
+    {}
+
+    ~MessageThreadCallQueue()
+    {
+        cancelPendingUpdate();
+    }
+
+    /** @brief Calls a function, via the queue, on the message thread.
+     * @see LockFreeCallQueue::callf()
+     *
+     * From the producer thread only.  Not wait-free: the first call after
+     * each drain posts a message, which can take a lock.
+     *
+     * @returns false if the queue was full and the call was dropped.
+     */
+    template <class Functor>
+    bool callf (Functor&& f)
+    {
+        const bool posted = queue.callf (std::forward<Functor> (f));
+
+        /* Even when the call was dropped, as a full queue is all the more
+         reason to get the message thread going. */
+        requestWakeup();
+        return posted;
+    }
+
+    /** @brief Calls object->method (args...) on the message thread.
+     * @see LockFreeCallQueue::callf() */
+    template <class Method, class Object, class... Args>
+    bool callf (Method method, Object* object, Args const&... args)
+    {
+        const bool posted = queue.callf (method, object, args...);
+        requestWakeup();
+        return posted;
+    }
+
+    /** @brief Limit how long each drain can keep the message thread busy.
+     *
+     * Whatever is left over when the time runs out stays in the queue, in
+     * order, and another drain is posted for it straight away, so the GUI
+     * gets a turn in between.  Message thread only.
+     *
+     * @param maxTime - or zero, the default, for no limit.
+     */
+    void setMaxDrainTime (RelativeTime maxTime)
+    {
+        maxDrainTime = maxTime;
+    }
+
+    /** @brief Run the waiting calls now, rather than waiting for the
+     * callback.  Message thread only. */
+    void synchronize()
+    {
+        /* Clear the flag before draining.  A callf() that comes in after this
+         posts another wakeup, so nothing is left sitting in the queue.  An
+         exchange rather than a store, so that if we see a callf()'s flag we
+         see its call too. */
+        wakeupPending.value.exchange (false, std::memory_order_acq_rel);
+
+        if (maxDrainTime.inSeconds() <= 0.0)
+        {
+            queue.synchronize();
+        }
+        else if (queue.synchronize (maxDrainTime) > 0)
+        {
+            requestWakeup();
+        }
+    }
+
+    /** @brief The number of wakeup messages the audio thread has posted.  For
+     * checking the coalescing is working. */
+    uint32 getNumWakeupsPosted() const
+    {
+        return wakeupsPosted.value.load (std::memory_order_relaxed);
+    }
+
+    int getNumPendingCalls()
+    {
+        return queue.getNumPendingCalls();
+    }
+
+    CallQueueStatistics getStatistics() const
+    {
+        return queue.getStatistics();
+    }
+
+    /** @brief Refuse any more calls.  @see LockFreeCallQueue::stop() */
+    void stop()
+    {
+        queue.stop();
+    }
+
+private:
+    void requestWakeup()
+    {
+        if (! wakeupPending.value.exchange (true, std::memory_order_acq_rel))
+        {
+            wakeupsPosted.value.fetch_add (1, std::memory_order_relaxed);
+            triggerAsyncUpdate();
+        }
+    }
+
+    void handleAsyncUpdate() override
+    {
+        synchronize();
+    }
+
+    LockFreeCallQueue queue;
+    RelativeTime maxDrainTime;              /* message thread only. */
+
+    /* Set by the first callf() after a drain, cleared by the drain. */
+    PaddedAtomic<bool> wakeupPending;
+    PaddedAtomic<uint32> wakeupsPosted;
+
+    JUCE_DECLARE_NON_COPYABLE (MessageThreadCallQueue)
+};
+
+
+
+#endif  // MESSAGE_THREAD_CALL_QUEUE_H_INCLUDED
@@ -0,0 +1,267 @@
+/*
+  ==============================================================================
+
+    multi_producer_call_queue.h
+    Created: 17 Oct 2026
+
+  ==============================================================================
+*/
+
+#ifndef MULTI_PRODUCER_CALL_QUEUE_H_INCLUDED
+#define MULTI_PRODUCER_CALL_QUEUE_H_INCLUDED
+
+
+/**
+ * @brief A LockFreeCallQueue that any number of threads can post to.
+ *
+ * This is a many-writer, one-reader FIFO.  callf() can be used from as many
+ * threads as you like, at the same time, and synchronize() must be called
+ * from a single thread - typically the audio callback.  Use it when the GUI,
+ * a MIDI learn thread, a sample loader and so on all need to get work to the
+ * audio thread, instead of polling one LockFreeCallQueue per producer.
+ *
+ * It has the same special features as LockFreeCallQueue:
+ *   - No locking.  Producers claim space with a compare-and-swap, the consumer
+ *   never waits on them.
+ *   - Avoids using the system allocator except during the constructor.
+ *
+ * Each call is placed in a slot that starts with a small header.  The
+ * producer fills in the slot then publishes it by setting the header's size,
+ * so producers can finish in any order and synchronize() will stop at the
+ * first slot that isn't ready yet, preserving the order in which space was
+ * claimed.  Calls from any one thread arrive in the order they were made.
+ *
+ *   Watch out for:
+ *   - A producer that is descheduled between claiming a slot and publishing
+ *   it holds up everything queued behind it until it runs again.
+ *   - The buffer size is rounded up to a power of two.
+ *
+ * ## Unit Tests
+ * A unit-test is provided in the _tests directory which be useful reference.
+ */
+class MultiProducerCallQueue
+    : public CacheLineAlignedObject,
+      private CallQueueBase
+{
+public:
+    MultiProducerCallQueue (int RingBufferSize)
+        :
+        bufferSize (roundUpToPowerOfTwo (roundUpToCacheLineBoundary (RingBufferSize))),
+        acceptingJobs (true)
+    {
+        /* As in LockFreeCallQueue, an item that won't fit before the end of the
+         ring leaves an empty slot and starts again at the beginning. */
+        rawdata = new char[ bufferSize + cacheLineSize ];
+        fifodata = rawdata + getPaddingForAlignment (rawdata, cacheLineSize);
+
+        /* Any cache line can be the start of a slot. */
+        for (int i = 0; i < bufferSize; i += cacheLineSize)
+            new (fifodata + i) SlotHeader();
+    }
+
+    ~MultiProducerCallQueue()
+    {
+        memoryLock.unlock();
+        delete [] rawdata;
+    }
+
+    /** @brief Ask the OS to keep the queue's memory in RAM.  The constructor
+     * has already written to every page.
+     * @see LockFreeCallQueue::lockMemory() */
+    bool lockMemory()
+    {
+        return memoryLock.lock (fifodata, static_cast<size_t> (bufferSize));
+    }
+
+    /** @brief return true if the queue is empty.  Includes calls that are
+     * still being written. */
+    bool isEmpty()
+    {
+        return readPosition.value.load (std::memory_order_acquire)
+               == writePosition.value.load (std::memory_order_acquire);
+    }
+
+    /** @brief Return the amount of free space in the queue.
+     *
+     * Only a snapshot - other producers may fill it before you get to use it.
+     * @see LockFreeCallQueue::getFreeSpace()
+     */
+    int getFreeSpace()
+    {
+        const uint32 readPos = readPosition.value.load (std::memory_order_acquire);
+        const uint32 writePos = writePosition.value.load (std::memory_order_acquire);
+        return bufferSize - static_cast<int> (writePos - readPos);
+    }
+
+    /**
+     * @brief Calls a function, via the queue, on the consumer thread.
+     *
+     * Safe to call from several threads at once.  Returns false if the queue
+     * is full, and the call is dropped.  As with LockFreeCallQueue, an rvalue
+     * functor is moved in, and is left alone if the call is dropped.
+     * @see LockFreeCallQueue::callf()
+     */
+    template <class Functor>
+    bool callf (Functor&& f)
+    {
+        typedef WorkItem<typename std::decay<Functor>::type> Item;
+
+        static_assert (alignof (Item) <= cacheLineSize,
+                       "MultiProducerCallQueue can't align a functor beyond a cache line");
+
+        if (! acceptingJobs.load (std::memory_order_relaxed))
+            return false;
+
+        const int itemOffset = static_cast<int> (getItemOffset (alignof (Item)));
+        const int slotSize = roundUpToCacheLineBoundary (itemOffset + static_cast<int> (sizeof (Item)));
+
+        uint32 writePos = writePosition.value.load (std::memory_order_relaxed);
+        int tailGap;
+
+        /* Claim space.  If the slot won't fit before the end of the ring, claim
+         the tail of the ring too and start the slot at the beginning. */
+        for (;;)
+        {
+            const int offset = static_cast<int> (writePos & (bufferSize - 1));
+            tailGap = offset + slotSize > bufferSize ? bufferSize - offset : 0;
+
+            const uint32 readPos = readPosition.value.load (std::memory_order_acquire);
+
+            if (bufferSize - static_cast<int> (writePos - readPos) < tailGap + slotSize)
+                return false;
+
+            if (writePosition.value.compare_exchange_weak (writePos, writePos + static_cast<uint32> (tailGap + slotSize),
+                                                           std::memory_order_relaxed))
+                break;
+        }
+
+        const int offset = static_cast<int> (writePos & (bufferSize - 1));
+
+        if (tailGap > 0)
+            publish (getHeader (offset), tailGap, 0);
+
+        const int slotOffset = tailGap > 0 ? 0 : offset;
+        new (fifodata + slotOffset + itemOffset) Item (std::forward<Functor> (f));
+        publish (getHeader (slotOffset), slotSize, itemOffset);
+
+        return true;
+    }
+
+    /** @brief Calls object->method (args...), via the queue, on the other thread.
+     *
+     * Does the same as callf (std::bind (method, object, args...)), but the call
+     * is stored in a compact record which, when the arguments are plain values,
+     * needs no destructor call on the receiving thread.
+
+    @code
+    queue.callf (&MyClass::update, this, i, j);
+    @endcode
+     */
+    template <class Method, class Object, class... Args>
+    bool callf (Method method, Object* object, Args const&... args)
+    {
+        return callf (MemberCall<Method, Object, typename std::decay<Args const>::type...> (method, object, args...));
+    }
+
+    /** @brief Execute all the calls in the queue.
+     *
+     * Call this function in the target thread.  Stops early if it reaches a
+     * call that a producer is still writing; that call, and anything after it,
+     * will be executed next time.
+     *
+     * @returns true if there was anything in the queue, false if the queue was
+     * empty.
+     * */
+    bool synchronize()
+    {
+        bool didSomething = false;
+        uint32 readPos = readPosition.value.load (std::memory_order_relaxed);
+
+        for (;;)
+        {
+            const int offset = static_cast<int> (readPos & (bufferSize - 1));
+            SlotHeader* header = getHeader (offset);
+            const int slotSize = header->size.load (std::memory_order_acquire);
+
+            if (slotSize == 0)
+                break;
+
+            if (header->itemOffset != 0)
+            {
+                didSomething = true;
+                Work* w = reinterpret_cast<Work*> (fifodata + offset + header->itemOffset);
+                /* notice only one function pointer invocation here, not two virtual function calls. */
+                (*w->execAndDestructFn) (w);
+            }
+
+            /* The work item will have written over the headers of the cache lines
+             after the first.  Clear the lot so a future slot starting on any of
+             them reads as unpublished. */
+            for (int i = 0; i < slotSize; i += cacheLineSize)
+                getHeader (offset + i)->size.store (0, std::memory_order_relaxed);
+
+            readPos += static_cast<uint32> (slotSize);
+            readPosition.value.store (readPos, std::memory_order_release);
+        }
+
+        return didSomething;
+    }
+
+    /** Disables this MultiProducerCallQueue.  @see LockFreeCallQueue::stop() */
+    void stop()
+    {
+        acceptingJobs = false;
+    }
+
+private:
+    /** Starts every slot.  A size of zero means the slot isn't ready; an
+     itemOffset of zero means the slot is padding at the end of the ring. */
+    struct SlotHeader
+    {
+        SlotHeader() : size (0), itemOffset (0) {}
+        std::atomic<int> size;
+        int itemOffset;
+    };
+
+    static size_t getItemOffset (size_t alignment)
+    {
+        return (sizeof (SlotHeader) + alignment - 1) & ~(alignment - 1);
+    }
+
+    static int roundUpToPowerOfTwo (int x)
+    {
+        int n = cacheLineSize;
+
+        while (n < x)
+            n <<= 1;
+
+        return n;
+    }
+
+    SlotHeader* getHeader (int offset)
+    {
+        return reinterpret_cast<SlotHeader*> (fifodata + offset);
+    }
+
+    static void publish (SlotHeader* header, int slotSize, int itemOffset)
+    {
+        header->itemOffset = itemOffset;
+        header->size.store (slotSize, std::memory_order_release);
+    }
+
+    const int bufferSize;
+    char* rawdata;
+    char* fifodata;
+    RealtimeMemoryLock memoryLock;
+    std::atomic<bool> acceptingJobs;
+
+    /* Free running byte counts, so a producer that stalls mid compare-and-swap
+     can't be fooled by the ring going all the way round.  Producers contend on
+     writePosition; readPosition is only written by the consumer. */
+    PaddedAtomic<uint32> writePosition;
+    PaddedAtomic<uint32> readPosition;
+};
+
+
+
+#endif  // MULTI_PRODUCER_CALL_QUEUE_H_INCLUDED
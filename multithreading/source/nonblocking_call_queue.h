@@ -11,6 +11,8 @@
 #ifndef AUDIOTHREAD_FIFO_H_INCLUDED
 #define AUDIOTHREAD_FIFO_H_INCLUDED
 
+class QueueSet;
+
 
 /**
  * @brief Allows a function call to be executed on a different thread, in a fast
@@ -24,7 +26,13 @@
  *
  * It has the following special features: 
  *   - No locking 
- *   - Avoids using the system allocator except during the constructor.  
+ *   - Avoids using the system allocator except during the constructor and
+ *   grow().  
+ *   - Each call gets its own cache-line aligned slot, and the read and write
+ *   positions live on separate cache lines, so the two threads don't fight
+ *   over the same memory.
+ *   - Optionally, a consumer that isn't realtime can sleep until there's
+ *   something to do.  See waitAndSynchronize().
  *
  *   Watch out for: 
  *   - Objects you pass as function arguments, which are passed by value, doing
@@ -35,28 +43,37 @@
  */
 
 class LockFreeCallQueue
+    : public CacheLineAlignedObject,
+      private CallQueueBase
 {
 public:
-    LockFreeCallQueue (int RingBufferSize)
+    /**
+     * @param RingBufferSize - size of the queue in bytes.
+     * @param allowConsumerToWait - set this if the consumer is a background
+     * thread that wants to use waitAndSynchronize().  It costs callf() a
+     * memory fence, so leave it off for audio thread consumers.
+     */
+    LockFreeCallQueue (int RingBufferSize, bool allowConsumerToWait = false)
         :
-        fifo (RingBufferSize),
-        acceptingJobs (true)
-    {
-        // TODO: data should be aligned to a cache line boundary.
-        // Allocate double size buffer to easily support variable length messages,
-        // by hanging them over the end of the buffer.
-        fifodata = new char[ RingBufferSize * 2 ];
-    }
-
-    ~LockFreeCallQueue()
+        ring (new Ring (roundUpToCacheLineBoundary (RingBufferSize))),
+        bufferSize (ring->size),
+        lockNewRings (false),
+        acceptingJobs (true),
+        consumerCanWait (allowConsumerToWait),
+        measureLatency (false),
+        overflowPolicy (dropCalls),
+        numMailboxes (0),
+        readyMask (nullptr),
+        readyBit (0)
     {
-        delete [] fifodata;
+        readRing.value = ring.get();
     }
 
     /** @brief return true if the queue is empty. */
     bool isEmpty()
     {
-        return fifo.getTotalSize() == fifo.getFreeSpace();
+        return readPosition.value.load (std::memory_order_acquire)
+               == writePosition.value.load (std::memory_order_acquire);
     }
 
     /** @brief Return the amount of free space in the queue. 
@@ -67,10 +84,92 @@ public:
      * guarantees of it not filling up during operation - so if something is
      * critical and your application will fail if it doesn't get through you 
      * may need to think about some signalling back. 
+     *
+     * Space is handed out in whole cache lines, and one line is always left
+     * unused so that a full queue can be told apart from an empty one.  A call
+     * that doesn't fit before the end of the ring also uses up the space left
+     * at the end, so a call may be refused with slightly more than its size
+     * free.
+     *
+     * Safe from any thread, as it only reads atomics: the ring itself belongs
+     * to the producer, and grow() can swap it out at any time.  Only a
+     * snapshot, and a rough one while the consumer is still finishing a ring
+     * that grow() replaced.
      */
     int getFreeSpace()
     {
-        return fifo.getFreeSpace();
+        const int readPos = readPosition.value.load (std::memory_order_acquire);
+        const int writePos = writePosition.value.load (std::memory_order_acquire);
+        /* After the write position, so it's at least as new as the ring it's in. */
+        const int size = bufferSize.load (std::memory_order_relaxed);
+        const int used = writePos >= readPos ? writePos - readPos : size - readPos + writePos;
+        return jmax (0, size - used - cacheLineSize);
+    }
+
+    /** @brief Keep the queue's memory in RAM, so neither side takes a page
+     * fault using it.
+     *
+     * Writes to every page of the ring now, then asks the OS to lock it in
+     * RAM.  Rings added later by grow() are treated the same way.  Call it
+     * before the queue is in use.  @see RealtimeMemoryLock
+     *
+     * @returns false if the OS wouldn't lock the memory, which is usually the
+     * limit on locked memory.  The pages have still been faulted in.
+     */
+    bool lockMemory()
+    {
+        lockNewRings = true;
+        return ring->lockMemory();
+    }
+
+    /** @brief Swap in a bigger ring without holding up the consumer.
+     *
+     * So a queue can start small and grow to fit the load it actually gets,
+     * e.g. from a timer that checks getStatistics().peakBytesUsed, instead of
+     * being sized for the worst case.  Calls made from now on go into the
+     * new ring.  The consumer finishes the calls in the old ring first, so
+     * they stay in order, then moves on at its next synchronize().  It never
+     * waits, allocates or frees anything to do so.  The old ring is freed on
+     * the producer thread, by the next grow() after the consumer has moved
+     * on, or when the queue is deleted.
+     *
+     * Producer thread only, and it allocates, so it's for producers that
+     * aren't realtime.  Don't call it while a Batch is open.
+     *
+     * @returns false if the queue is already at least that big, if the old
+     * ring is too full to take the note telling the consumer to move on, or
+     * if the consumer hasn't yet moved on from the ring the last grow()
+     * replaced.  Try again later in the latter two cases.
+     */
+    bool grow (int newBufferSize)
+    {
+        newBufferSize = roundUpToCacheLineBoundary (newBufferSize);
+
+        if (newBufferSize <= ring->size || ! releaseRetiredRing())
+            return false;
+
+        std::unique_ptr<Ring> next (new Ring (newBufferSize));
+        const int itemPos = reserve (writePosition.value.load (std::memory_order_relaxed),
+                                     sizeof (HandoffItem), alignof (HandoffItem), notScheduled);
+
+        if (itemPos < 0)
+            return false;
+
+        if (lockNewRings)
+            next->lockMemory();
+
+        /* Carry on in the new ring from just after the handoff.  That's a
+         valid position in the bigger ring, even at the very end of the old
+         one, so the read and write positions never need resetting. */
+        const int nextPos = itemPos + cacheLineSize;
+        new (ring->data + itemPos) HandoffItem (next.get(), nextPos);
+
+        retiredRing = std::move (ring);
+        ring = std::move (next);
+        bufferSize.store (ring->size, std::memory_order_relaxed);
+        writePosition.value.store (nextPos, std::memory_order_release);
+        notifyConsumer();
+        return true;
     }
 
     /**
@@ -93,32 +192,347 @@ public:
     };
     @endcode
 
+     * Pass a temporary, or std::move() a functor in, and it's moved straight
+     * into the queue.  So a functor can hand over ownership of a buffer or an
+     * object, in a std::unique_ptr say, in one move.
+     *
+     * @returns false if the call was dropped, because the queue is full or has
+     * been stopped.  A functor passed as an rvalue is left untouched when this
+     * happens, so you can try again.  With the spillToHeap overflow policy a
+     * full queue doesn't drop calls.
 
     */
     template <class Functor>
-    bool callf (Functor const& f)
+    bool callf (Functor&& f)
     {
-        if (! acceptingJobs) 
+        if (! acceptingJobs.load (std::memory_order_relaxed)) 
             return false;
 
-        /* allocSize cannot be bigger than 2Gb ok!. */
-        // jassert (sizeof (WorkItem<Functor>) < std::numeric_limits<int>::max());
+        return postOrSpill (std::forward<Functor> (f));
+    }
+
+    /** @brief Calls object->method (args...), via the queue, on the other thread.
+     *
+     * Does the same as callf (std::bind (method, object, args...)), but the call
+     * is stored in a compact record which, when the arguments are plain values,
+     * needs no destructor call on the receiving thread.
+
+    @code
+    queue.callf (&MyClass::update, this, i, j);
+    @endcode
+     */
+    template <class Method, class Object, class... Args>
+    bool callf (Method method, Object* object, Args const&... args)
+    {
+        return callf (MemberCall<Method, Object, typename std::decay<Args const>::type...> (method, object, args...));
+    }
+
+    /** @brief Calls a function on the other thread and hands its return value
+     * back through result.
+     *
+     * result is marked pending and filled in, without allocating or locking,
+     * when the call runs.  Poll it with CallResult::isReady() or wait for it
+     * with CallResult::waitForResult().  It must stay alive, and not be reused,
+     * until then.
+
+    @code
+    queue.callfWithResult (voiceCount, std::bind (&Synth::getNumActiveVoices, &synth));
+    @endcode
+     *
+     * @returns false, and leaves result empty, if the queue is full.
+     */
+    template <class ResultType, class Functor>
+    bool callfWithResult (CallResult<ResultType>& result, Functor&& f)
+    {
+        jassert (! result.isPending());
+        result.setPending();
+
+        if (callf (ResultCall<ResultType, typename std::decay<Functor>::type> (&result, std::forward<Functor> (f))))
+            return true;
+
+        result.cancelPending();
+        return false;
+    }
+
+    /** @brief Calls a function on the other thread, handing it a copy of a
+     * block of data.
+     *
+     * For sending a block of samples, a wavetable frame or a MIDI packet
+     * without a preallocated buffer or a GarbageCollectedObject.  The data is
+     * copied into the queue straight after the call, in the same slot, and
+     * the call is run as f (data, numItems) with a pointer to that copy.  So
+     * it takes one copy into the queue and no allocation.  The pointer is
+     * only valid while the call runs.
+
+    @code
+    queue.callfWithPayload (frame.getData(), frame.size(), [this] (const float* data, int numSamples)
+    {
+        wavetable.setFrame (data, numSamples);
+    });
+    @endcode
+     *
+     * Type must be trivially copyable.  The data uses queue space, so size
+     * the queue for the biggest block you'll send, plus the call.  Calls are
+     * dropped, not spilled, when the queue is full, whatever the overflow
+     * policy.
+     *
+     * @returns false if the call was dropped, because the queue is full or
+     * has been stopped.
+     */
+    template <class Type, class Functor>
+    bool callfWithPayload (const Type* data, int numItems, Functor&& f)
+    {
+        static_assert (std::is_trivially_copyable<Type>::value,
+                       "callfWithPayload() copies the data with memcpy");
+        typedef PayloadItem<typename std::decay<Functor>::type, Type> Item;
+        jassert (numItems >= 0);
+
+        if (! acceptingJobs.load (std::memory_order_relaxed))
+            return false;
+
+        const int payloadSize = numItems * static_cast<int> (sizeof (Type));
+        const int itemSize = Item::getPayloadOffset() + payloadSize;
 
-        const int allocSize = static_cast<int>(roundUpToCacheLineBoundary (sizeof (WorkItem<Functor>)));
-        int idx1, idx2, sz1, sz2;
-        fifo.prepareToWrite (allocSize, idx1, sz1, idx2, sz2);
+        /* Spilled calls have to go first, so a payload can't overtake them. */
+        const int writePos = writePosition.value.load (std::memory_order_relaxed);
+        const int itemPos = flushSpilledCalls() ? reserve (writePos, itemSize, jmax (alignof (Item), alignof (Type)), notScheduled)
+                                                : -1;
 
-        if (sz1 + sz2 < allocSize) 
+        if (itemPos < 0)
+        {
+            increment (callsDropped);
             return false;
+        }
 
-        /* double size buffer means we can ignore idx2 and sz2.  Weird syntax for new is a 'placement
-         * new'.  Familar only if you write custom allocators regularly. */
-        new (fifodata + idx1) WorkItem<Functor> (f);
-        fifo.finishedWrite (allocSize);
+        CallQueueLatencyHistogram* histogram = measureLatency.load (std::memory_order_relaxed) ? &latencyHistogram : nullptr;
+        Item* item = new (ring->data + itemPos) Item (std::forward<Functor> (f), numItems, histogram);
+
+        if (payloadSize > 0)
+            memcpy (item->getPayload(), data, static_cast<size_t> (payloadSize));
+
+        publish (itemPos + roundUpToCacheLineBoundary (itemSize));
 
         return true;
     }
 
+    /**
+     * @brief Adds a run of calls to the queue in one go.
+     *
+     * For the hundreds of calls that loading a preset makes.  The calls are
+     * written into the queue one after another but the consumer sees none of
+     * them until the batch is committed, which publishes them all with a
+     * single store.  It's all or nothing: if a call doesn't fit, the calls
+     * already in the batch are thrown away and the rest are refused.
+     * Batches are dropped, not spilled, when the queue is full, whatever the
+     * overflow policy.
+
+    @code
+    {
+        LockFreeCallQueue::Batch batch (queue);
+
+        for (int i = 0; i < numParameters; ++i)
+            batch.callf (&Synth::setParameter, &synth, i, preset[i]);
+
+    }   // committed here.
+    @endcode
+     *
+     * Producer thread only.  Don't use the queue's own callf() while a batch
+     * is open, as it would write over the batch.
+     */
+    class Batch
+    {
+    public:
+        explicit Batch (LockFreeCallQueue& q)
+            :
+            queue (q),
+            startPos (q.writePosition.value.load (std::memory_order_relaxed)),
+            writePos (startPos),
+            numCalls (0),
+            failed (! q.acceptingJobs.load (std::memory_order_relaxed) || ! q.flushSpilledCalls())
+        {}
+
+        /** Commits anything not yet committed. */
+        ~Batch()
+        {
+            commit();
+        }
+
+        /** @brief Adds a call to the batch.  @see LockFreeCallQueue::callf()
+         * @returns false if the batch has been dropped. */
+        template <class Functor>
+        bool callf (Functor&& f)
+        {
+            typedef typename std::decay<Functor>::type Call;
+
+            if (queue.measureLatency.load (std::memory_order_relaxed))
+                return add<TimedCall<Call>> (TimedCall<Call> (std::forward<Functor> (f), &queue.latencyHistogram));
+
+            return add<Call> (std::forward<Functor> (f));
+        }
+
+        /** @brief Adds object->method (args...) to the batch. */
+        template <class Method, class Object, class... Args>
+        bool callf (Method method, Object* object, Args const&... args)
+        {
+            return callf (MemberCall<Method, Object, typename std::decay<Args const>::type...> (method, object, args...));
+        }
+
+        /** @brief Publish the calls added so far.  More can be added afterwards,
+         * as a new batch.
+         * @returns false if the batch was dropped. */
+        bool commit()
+        {
+            if (failed)
+                return false;
+
+            if (numCalls > 0)
+            {
+                jassert (queue.writePosition.value.load (std::memory_order_relaxed) == startPos);
+
+                queue.publish (writePos, numCalls);
+                startPos = writePos;
+                numCalls = 0;
+            }
+
+            return true;
+        }
+
+        /** @brief Throw away the calls added since the last commit().  Calls
+         * added afterwards go in their place. */
+        void cancel()
+        {
+            /* Nothing here has been run, so destroy each call without running
+             it, then write over them from the last commit. */
+            for (int pos = startPos; pos != writePos;)
+            {
+                Work* w = reinterpret_cast<Work*> (queue.ring->data + pos);
+                const int size = isSkipItem (w) ? (*w->execAndDestructFn) (w)
+                                                : (*static_cast<BatchWork*> (w)->destroyFn) (w);
+                pos = queue.ring->wrapPosition (pos + roundUpToCacheLineBoundary (size));
+            }
+
+            writePos = startPos;
+            numCalls = 0;
+        }
+
+        /** @brief The number of calls waiting to be committed. */
+        int getNumCalls() const
+        {
+            return static_cast<int> (numCalls);
+        }
+
+    private:
+        template <class Call, class F>
+        bool add (F&& f)
+        {
+            typedef BatchItem<Call> Item;
+            const int itemPos = failed ? -1 : queue.reserve (writePos, sizeof (Item), alignof (Item), notScheduled);
+
+            if (itemPos < 0)
+            {
+                if (! failed)
+                {
+                    queue.increment (queue.callsDropped, numCalls);
+                    cancel();
+                    failed = true;
+                }
+
+                if (queue.acceptingJobs.load (std::memory_order_relaxed))
+                    queue.increment (queue.callsDropped);
+
+                return false;
+            }
+
+            new (queue.ring->data + itemPos) Item (std::forward<F> (f));
+            writePos = queue.ring->wrapPosition (itemPos + roundUpToCacheLineBoundary (static_cast<int> (sizeof (Item))));
+            ++numCalls;
+            return true;
+        }
+
+        LockFreeCallQueue& queue;
+        int startPos;
+        int writePos;
+        uint32 numCalls;
+        bool failed;
+
+        JUCE_DECLARE_NON_COPYABLE (Batch)
+    };
+
+    /** @brief Set up the keys for callfCoalesced().
+     *
+     * Keys run from 0 to numKeys - 1, e.g. one per parameter.  Allocates, so
+     * call it before the queue is in use.
+     */
+    void setNumCoalescingKeys (int numKeys)
+    {
+        mailboxes.reset (numKeys > 0 ? new Mailbox[numKeys] : nullptr);
+        numMailboxes = numKeys;
+    }
+
+    /** @brief Calls a function on the other thread, unless a newer call with
+     * the same key gets there first.
+     *
+     * For floods of updates where only the latest matters, like parameter
+     * changes during a knob drag.  Each key has a small mailbox holding the
+     * latest call.  Only the first call after the consumer has emptied the
+     * mailbox puts anything in the queue; later ones just replace the call in
+     * the mailbox.  So the queue space used, and the work done by
+     * synchronize(), is bounded by the number of keys rather than the rate
+     * at which calls are made.
+     *
+     * The call runs at the position in the queue of the first call that
+     * wasn't coalesced, but with the latest functor.
+
+    @code
+    queue.setNumCoalescingKeys (numParameters);
+    ...
+    queue.callfCoalesced (index, &Synth::setParameter, &synth, index, value);
+    @endcode
+     *
+     * The functor must be trivially copyable and no bigger than a cache line
+     * with its header, which a lambda capturing a few plain values will be.
+     *
+     * @returns false if the queue was full.  The call is kept in the mailbox
+     * and goes out with the next call for the same key.
+     */
+    template <class Functor>
+    bool callfCoalesced (int key, Functor const& f)
+    {
+        static_assert (std::is_trivially_copyable<Functor>::value,
+                       "callfCoalesced() needs a trivially copyable functor");
+        static_assert (sizeof (WorkItem<Functor>) <= sizeof (Mailbox::Slot)
+                       && alignof (WorkItem<Functor>) <= alignof (Mailbox::Slot),
+                       "functor is too big for callfCoalesced()");
+        jassert (isPositiveAndBelow (key, numMailboxes));
+
+        if (! acceptingJobs.load (std::memory_order_relaxed))
+            return false;
+
+        Mailbox& m = mailboxes[key];
+        new (&m.slots[m.back]) WorkItem<Functor> (f);
+
+        /* Swap the new call into the middle slot.  Release so the consumer sees
+         the call, acquire so we don't overwrite one it's still running. */
+        const uint8 previous = m.state.exchange ((uint8) (m.back | Mailbox::dirty), std::memory_order_acq_rel);
+        m.back = previous & Mailbox::indexMask;
+
+        /* If the mailbox was already full, its notification is still queued. */
+        if ((previous & Mailbox::dirty) != 0 && ! m.needsNotification)
+            return true;
+
+        CoalescedCall notification = { this, key };
+        m.needsNotification = ! postOrSpill (notification);
+        return ! m.needsNotification;
+    }
+
+    /** @brief callfCoalesced() for object->method (args...), which is stored
+     * compactly enough for plain value arguments.  @see callf() */
+    template <class Method, class Object, class... Args>
+    bool callfCoalesced (int key, Method method, Object* object, Args const&... args)
+    {
+        return callfCoalesced (key, MemberCall<Method, Object, typename std::decay<Args const>::type...> (method, object, args...));
+    }
+
     /** @brief Execute all the calls in the queue. 
      *
      * Call this function in the target thread.  When this function is called
@@ -131,21 +545,292 @@ public:
     {
         bool didSomething = false;
 
-        while (fifo.getNumReady() > 0)
-        {
-            int idx1, idx2, sz1, sz2;
-            fifo.prepareToRead (1, idx1, sz1, idx2, sz2);
+        while (executeNextCall())
             didSomething = true;
-            Work* w = reinterpret_cast<Work*> (fifodata + idx1);
-            /* notice only one function pointer invocation here, not two virtual function calls. */
-            const int sizeofWorkItem = (*w->execAndDestructFn) (w);
-            const int allocSize = roundUpToCacheLineBoundary (sizeofWorkItem);
-            fifo.finishedRead (allocSize);
+
+        return didSomething;
+    }
+
+    /** @brief Calls a function, via the queue, when the consumer reaches a
+     * given sample.
+     *
+     * For sample accurate parameter changes.  The consumer calls
+     * synchronizeUntil() with the end of each section of audio it's about to
+     * render, and uses getNextCallTime() to find where to split its block.
+     * samplePosition is on whatever timeline the consumer uses, e.g. samples
+     * since playback started.  The queue is still a FIFO: make calls in order
+     * of samplePosition, as one due earlier than the call in front of it will
+     * wait for that one.  Calls made with callf() are due straight away.
+     *
+     * Costs an extra cache line of queue space per call.  Calls are dropped,
+     * not spilled, when the queue is full, whatever the overflow policy, and
+     * when there are spilled calls that still don't fit.
+
+    @code
+    void processBlock (AudioBuffer<float>& buffer, MidiBuffer&)
+    {
+        const int numSamples = buffer.getNumSamples();
+        int start = 0;
+
+        while (start < numSamples)
+        {
+            // Run everything due up to and including this sample, then render
+            // up to the next call.
+            queue.synchronizeUntil (position + start + 1);
+            const int64 next = jlimit (position + start + 1, position + numSamples, queue.getNextCallTime());
+            const int end = (int) (next - position);
+            render (buffer, start, end - start);
+            start = end;
         }
 
+        position += numSamples;
+    }
+    @endcode
+     */
+    template <class Functor>
+    bool callAt (int64 samplePosition, Functor&& f)
+    {
+        jassert (samplePosition != notScheduled);
+
+        if (! acceptingJobs.load (std::memory_order_relaxed))
+            return false;
+
+        /* Spilled calls have to go first, so this can't overtake them. */
+        const bool posted = flushSpilledCalls() && post (std::forward<Functor> (f), samplePosition);
+
+        if (! posted)
+            increment (callsDropped);
+
+        return posted;
+    }
+
+    /** @brief callAt() for object->method (args...).  @see callf() */
+    template <class Method, class Object, class... Args>
+    bool callAt (int64 samplePosition, Method method, Object* object, Args const&... args)
+    {
+        return callAt (samplePosition, MemberCall<Method, Object, typename std::decay<Args const>::type...> (method, object, args...));
+    }
+
+    /** @brief Execute calls until reaching one from callAt() that's due at or
+     * after endSample.
+     *
+     * Calls made with callf() are always executed.  Call this from the target
+     * thread.  @see callAt()
+     *
+     * @returns true if any calls were executed.
+     */
+    bool synchronizeUntil (int64 endSample)
+    {
+        bool didSomething = false;
+
+        while (executeNextCall (endSample))
+            didSomething = true;
+
         return didSomething;
     }
 
+    /** @brief When the call at the front of the queue is due.
+     *
+     * Returns its samplePosition for a call from callAt(), the lowest
+     * possible value for a call from callf(), which is due straight away,
+     * or the highest possible value if the queue is empty.  Consumer thread
+     * only.
+     */
+    int64 getNextCallTime()
+    {
+        Work* w = peekNextItem();
+
+        if (w == nullptr)
+            return std::numeric_limits<int64>::max();
+
+        if (isSampleTimeItem (w))
+            return static_cast<SampleTimeItem*> (w)->samplePosition;
+
+        return std::numeric_limits<int64>::min();
+    }
+
+    /** @brief Execute up to maxItems calls from the queue.
+     *
+     * Use this instead of synchronize() when a burst of calls, say after a
+     * preset load, could take longer than your audio callback has.  Whatever
+     * is left over stays in the queue, in order, for next time.
+     *
+     * @returns the number of calls still waiting to be executed.
+     */
+    int synchronize (int maxItems)
+    {
+        executeCalls (maxItems);
+        return getNumPendingCalls();
+    }
+
+    /** @brief Execute up to maxItems calls, like synchronize (int maxItems).
+     *
+     * For a consumer that needs to know how much it did rather than how much
+     * is left.  Comparing getNumPendingCalls() before and after doesn't work,
+     * as the producer can add calls in between.
+     *
+     * @returns the number of calls executed.
+     */
+    int executeCalls (int maxItems)
+    {
+        int numExecuted = 0;
+
+        while (numExecuted < maxItems && executeNextCall())
+            ++numExecuted;
+
+        return numExecuted;
+    }
+
+    /** @brief Execute calls from the queue until maxTime has passed.
+     *
+     * The clock is checked after each call, so one slow call can still
+     * overrun.  At least one call is always executed, if there is one, so the
+     * queue keeps moving however small the budget.
+     *
+     * @returns the number of calls still waiting to be executed.
+     */
+    int synchronize (RelativeTime maxTime)
+    {
+        const int64 deadline = Time::getHighResolutionTicks()
+                               + Time::secondsToHighResolutionTicks (maxTime.inSeconds());
+
+        while (executeNextCall())
+            if (Time::getHighResolutionTicks() >= deadline)
+                break;
+
+        return getNumPendingCalls();
+    }
+
+    /** @brief Wait for calls to arrive, then execute them.
+     *
+     * For consumers on a background thread, instead of polling synchronize()
+     * in a loop with a sleep.  Spins for a moment in case something is about
+     * to arrive, then sleeps until callf() wakes it.  The producer only
+     * signals when the consumer has actually gone to sleep, so a busy queue
+     * costs nothing extra.  Needs allowConsumerToWait set in the constructor.
+     * Don't use this on the audio thread.
+     *
+     * @param timeOutMilliseconds - give up waiting after this long, or -1 to
+     * wait until something arrives or stop() is called.
+     * @returns true if any calls were executed.
+     */
+    bool waitAndSynchronize (int timeOutMilliseconds = -1)
+    {
+        jassert (consumerCanWait);
+
+        for (int i = 0; i < consumerSpinCount; ++i)
+            if (! isEmpty())
+                return synchronize();
+
+        consumerParked.value.store (true, std::memory_order_relaxed);
+        /* Pairs with the fence in wakeConsumerIfParked(): either we see the
+         new call, or the producer sees that we're parked. */
+        std::atomic_thread_fence (std::memory_order_seq_cst);
+
+        if (isEmpty() && acceptingJobs.load (std::memory_order_relaxed))
+            callsAvailable.wait (timeOutMilliseconds);
+
+        consumerParked.value.store (false, std::memory_order_relaxed);
+        return synchronize();
+    }
+
+    /** @brief Return the number of calls waiting to be executed.
+     *
+     * Like getFreeSpace() this is only a snapshot if called from the producer
+     * thread while the consumer is running, or vice versa.
+     */
+    int getNumPendingCalls()
+    {
+        const uint32 written = callsWritten.value.load (std::memory_order_relaxed);
+        const uint32 read = callsRead.value.load (std::memory_order_relaxed);
+        return static_cast<int> (written - read);
+    }
+
+    /** @brief What callf() does when the queue is full. */
+    enum OverflowPolicy
+    {
+        /** callf() returns false and the call is lost.  The default, and the
+         only choice for a realtime producer. */
+        dropCalls,
+        /** callf() copies the call to the heap, on the producer's side, and
+         posts it later when there's room.  Calls still arrive in order: while
+         anything is spilled, new calls are spilled behind it.  Suits producers
+         like the GUI thread, where a lost call is worse than an allocation.
+         The consumer never sees the heap copy, so synchronize() stays
+         allocation free. */
+        spillToHeap
+    };
+
+    /** @brief Set the overflow policy.  Producer thread only. */
+    void setOverflowPolicy (OverflowPolicy newPolicy)
+    {
+        overflowPolicy = newPolicy;
+    }
+
+    /** @brief Post as many spilled calls as will fit.
+     *
+     * callf() does this before each new call, but if the producer goes quiet
+     * after a burst you'll need to call this, from a timer say, to get the
+     * rest of the spilled calls through.  Producer thread only.
+     *
+     * @returns true if there are no spilled calls left.
+     */
+    bool flushSpilledCalls()
+    {
+        while (! spilledCalls.empty())
+        {
+            if (! spilledCalls.front()->postTo (*this))
+                return false;
+
+            spilledCalls.pop_front();
+        }
+
+        return true;
+    }
+
+    /** @brief The number of calls waiting on the producer's side for room in
+     * the queue.  Producer thread only. */
+    int getNumSpilledCalls() const
+    {
+        return static_cast<int> (spilledCalls.size());
+    }
+
+    /** @brief Read the queue's counters.
+     *
+     * Safe to call from any thread, e.g. a timer on the message thread.  The
+     * counters are updated with relaxed stores by the side that owns them, so
+     * reading them doesn't slow down either end.
+     */
+    CallQueueStatistics getStatistics() const
+    {
+        CallQueueStatistics s;
+        s.callsMade = callsWritten.value.load (std::memory_order_relaxed);
+        s.callsExecuted = callsRead.value.load (std::memory_order_relaxed);
+        s.callsDropped = callsDropped.value.load (std::memory_order_relaxed);
+        s.callsSpilled = callsSpilled.value.load (std::memory_order_relaxed);
+        s.peakBytesUsed = peakBytesUsed.value.load (std::memory_order_relaxed);
+        s.bufferSize = bufferSize.load (std::memory_order_relaxed);
+        return s;
+    }
+
+    /** @brief Time every call from callf() to when it's run.
+     *
+     * Off by default.  When on, each call carries a timestamp, so it costs
+     * two clock reads and an extra few bytes per call.  Calls already in the
+     * queue aren't affected.  @see getLatencyHistogram()
+     */
+    void setMeasureLatency (bool shouldMeasure)
+    {
+        measureLatency.store (shouldMeasure, std::memory_order_relaxed);
+    }
+
+    /** @brief Enqueue-to-execute times for calls made with
+     * setMeasureLatency (true).  Safe to read from any thread. */
+    const CallQueueLatencyHistogram& getLatencyHistogram() const
+    {
+        return latencyHistogram;
+    }
+
     /** Disables the this LockFreeCallQueue. You may need to use this during shutdown to avoid
      * threads continuing to put work, and objects, into a queue that no longer has anyone executing 
      * it.  It's probably not a big deal in an application, but in a plugin you could end up with 
@@ -155,73 +840,595 @@ public:
     void stop()
     {
         acceptingJobs = false;
+
+        if (consumerCanWait)
+            callsAvailable.signal();
     }
 private:
-    /* Avoid a vtable and two separate virtual function dispatches (operator() and destructor) by putting
-     everything into a single function and implementing our own virtual function call. */
+    template <class Functor>
+    bool postOrSpill (Functor&& f)
+    {
+        if (overflowPolicy == dropCalls)
+        {
+            if (post (std::forward<Functor> (f)))
+                return true;
 
-    /** 
-     Type for pointer to a function that executes work, calls the destructor for the and
-     returns size of concrete instance.
-     */
-    typedef int (*WorkExecAndDestructFunctionPtr) (void* workItemStorage);
+            increment (callsDropped);
+            return false;
+        }
+
+        /* post() leaves f alone if it fails, so it's still there to spill. */
+        if (flushSpilledCalls() && post (std::forward<Functor> (f)))
+            return true;
+
+        typedef SpilledCallOf<typename std::decay<Functor>::type> Spilled;
+        spilledCalls.push_back (std::unique_ptr<SpilledCall> (new Spilled (std::forward<Functor> (f))));
+        increment (callsSpilled);
+        return true;
+    }
 
-    class Work
+    /* Write a call into the ring.  Returns false, without touching f, if
+     there's no room.  A call from callAt() gets a SampleTimeItem in the cache
+     line in front of it, and the two are published together. */
+    template <class Functor>
+    bool post (Functor&& f, int64 samplePosition = notScheduled)
     {
-        // NOTE: no vtable.
-    public:
-        Work (WorkExecAndDestructFunctionPtr f) :
-            execAndDestructFn (f)
-        { }
-        WorkExecAndDestructFunctionPtr execAndDestructFn;
+        typedef typename std::decay<Functor>::type Call;
+        const int writePos = writePosition.value.load (std::memory_order_relaxed);
+
+        if (measureLatency.load (std::memory_order_relaxed))
+        {
+            typedef WorkItem<TimedCall<Call>> Item;
+            const int itemPos = reserve (writePos, sizeof (Item), alignof (Item), samplePosition);
+
+            if (itemPos < 0)
+                return false;
+
+            new (ring->data + itemPos) Item (TimedCall<Call> (std::forward<Functor> (f), &latencyHistogram));
+            publish (itemPos + roundUpToCacheLineBoundary (static_cast<int> (sizeof (Item))));
+        }
+        else
+        {
+            typedef WorkItem<Call> Item;
+            const int itemPos = reserve (writePos, sizeof (Item), alignof (Item), samplePosition);
+
+            if (itemPos < 0)
+                return false;
+
+            /* Weird syntax for new is a 'placement new'.  Familar only if you
+             * write custom allocators regularly. */
+            new (ring->data + itemPos) Item (std::forward<Functor> (f));
+            publish (itemPos + roundUpToCacheLineBoundary (static_cast<int> (sizeof (Item))));
+        }
+
+        return true;
+    }
+
+    /* Find room for an item at writePos, writing any SampleTimeItem and
+     SkipItem that go in front of it.  Returns where the item goes, or -1 if
+     the queue is full.  Nothing is visible to the consumer until publish(). */
+    int reserve (int writePos, size_t itemSize, size_t alignment, int64 samplePosition)
+    {
+        /* allocSize cannot be bigger than 2Gb ok!. */
+        // jassert (itemSize < std::numeric_limits<int>::max());
+
+        const int timeSize = samplePosition != notScheduled ? cacheLineSize : 0;
+        const int itemStart = ring->wrapPosition (writePos + timeSize);
+        const int allocSize = roundUpToCacheLineBoundary (static_cast<int> (itemSize));
+        const int padding = ring->getPaddingBeforeItem (itemStart, allocSize, alignment);
+        const int spaceNeeded = timeSize + padding + allocSize;
+
+        /* Work from the read position we saw last time.  The consumer only ever
+         frees space, so we only need to look at the real one, and pull its
+         cache line across, when the queue looks full. */
+        if (ring->size - ring->getUsedSpace (cachedReadPosition.value, writePos) - cacheLineSize < spaceNeeded)
+        {
+            cachedReadPosition.value = readPosition.value.load (std::memory_order_acquire);
+
+            if (ring->size - ring->getUsedSpace (cachedReadPosition.value, writePos) - cacheLineSize < spaceNeeded)
+                return -1;
+        }
+
+        if (timeSize > 0)
+            new (ring->data + writePos) SampleTimeItem (samplePosition);
+
+        /* Functors with an alignment bigger than a cache line get pushed along to
+         * the next suitable address, and items that won't fit before the end of
+         * the ring go to the start.  Either way a SkipItem fills the gap.  Items
+         * are never split in two. */
+        if (padding > 0)
+            new (ring->data + itemStart) SkipItem (padding);
+
+        return ring->wrapPosition (itemStart + padding);
+    }
+
+    /* Hand everything up to itemEnd to the consumer. */
+    void publish (int itemEnd, uint32 numCalls = 1)
+    {
+        increment (callsWritten, numCalls);
+        writePosition.value.store (ring->wrapPosition (itemEnd), std::memory_order_release);
+        notifyConsumer();
+    }
+
+    /* Tell the consumer there's something new, by waking it if it's asleep
+     in waitAndSynchronize() and by flagging this queue in its QueueSet. */
+    void notifyConsumer()
+    {
+        if (consumerCanWait)
+            wakeConsumerIfParked();
+
+        /* An RMW, not a plain store, so a concurrent QueueSet::synchronize()
+         either takes the flag after our write position is visible, or leaves
+         it set for next time. */
+        if (readyMask != nullptr)
+            readyMask->fetch_or (readyBit, std::memory_order_release);
+    }
+
+    /* A triple buffer per coalescing key.  The producer writes to the back
+     slot, the consumer runs the front slot, and they swap with the middle
+     slot.  The dirty flag is set while the middle slot holds a call the
+     consumer hasn't taken. */
+    struct Mailbox
+    {
+        enum { indexMask = 3, dirty = 4 };
+        typedef std::aligned_storage<cacheLineSize>::type Slot;
+
+        Mailbox() : state (0), back (1), front (2), needsNotification (false) {}
+
+        Slot slots[3];
+        std::atomic<uint8> state;
+        uint8 back;                 /* producer only. */
+        uint8 front;                /* consumer only. */
+        bool needsNotification;     /* producer only. */
+    };
+
+    /* Goes through the ring to tell the consumer a mailbox has a call in it. */
+    struct CoalescedCall
+    {
+        void operator()()
+        {
+            queue->runCoalescedCall (key);
+        }
+
+        LockFreeCallQueue* queue;
+        int key;
+    };
+
+    void runCoalescedCall (int key)
+    {
+        Mailbox& m = mailboxes[key];
+
+        if ((m.state.load (std::memory_order_relaxed) & Mailbox::dirty) == 0)
+            return;
+
+        const uint8 previous = m.state.exchange (m.front, std::memory_order_acq_rel);
+        m.front = previous & Mailbox::indexMask;
+
+        /* Trivially destructible, so this only runs it. */
+        Work* w = reinterpret_cast<Work*> (&m.slots[m.front]);
+        (*w->execAndDestructFn) (w);
+    }
+
+    /* A call waiting on the producer's side for room in the ring. */
+    struct SpilledCall
+    {
+        virtual ~SpilledCall() {}
+        virtual bool postTo (LockFreeCallQueue& queue) = 0;
     };
 
-    /** WorkItem template - extends Work for each type of Functor */
     template <class Functor>
-    struct WorkItem : public Work
+    struct SpilledCallOf : public SpilledCall
     {
-        explicit WorkItem (Functor const& fun) :
-            Work (&WorkItem::myExecAndDestruct),
-            myCall (fun)
+        template <class F>
+        explicit SpilledCallOf (F&& f) : call (std::forward<F> (f)) {}
+
+        /* The call is moved into the ring, and this holder freed, on the
+         producer's thread. */
+        bool postTo (LockFreeCallQueue& queue) override
+        {
+            return queue.post (std::move (call));
+        }
+
+        Functor call;
+    };
+
+    /* For counters that only one thread writes. */
+    static void increment (PaddedAtomic<uint32>& counter, uint32 amount = 1)
+    {
+        counter.value.store (counter.value.load (std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+    }
+
+    /* The call made by callfWithResult(). */
+    template <class ResultType, class Functor>
+    struct ResultCall
+    {
+        template <class F>
+        ResultCall (CallResult<ResultType>* r, F&& f) : result (r), call (std::forward<F> (f)) {}
+
+        void operator()()
+        {
+            result->setResult (call());
+        }
+
+        CallResult<ResultType>* result;
+        Functor call;
+    };
+
+    /* A call from a Batch.  Batch calls can be thrown away before they're
+     published, so they carry a second function that destroys them without
+     running them. */
+    struct BatchWork : public Work
+    {
+        BatchWork (WorkExecAndDestructFunctionPtr exec, WorkExecAndDestructFunctionPtr destroy)
+            : Work (exec), destroyFn (destroy)
         {}
 
-    private:
-        static int myExecAndDestruct (void* workItemStorage)
+        WorkExecAndDestructFunctionPtr destroyFn;
+    };
+
+    template <class Functor>
+    struct BatchItem : public BatchWork
+    {
+        template <class F>
+        explicit BatchItem (F&& f)
+            : BatchWork (&BatchItem::execAndDestruct, &BatchItem::destroy),
+              call (std::forward<F> (f))
+        {}
+
+        static int execAndDestruct (void* workItemStorage)
+        {
+            BatchItem* that = reinterpret_cast<BatchItem*> (workItemStorage);
+            that->call();
+            that->~BatchItem();
+            return static_cast<int> (sizeof (BatchItem));
+        }
+
+        static int destroy (void* workItemStorage)
         {
-            /* cast to *concrete* work item pointer of this template type */
-            WorkItem* that = reinterpret_cast<WorkItem*> (workItemStorage);
-            that->myCall();
-            that->~WorkItem(); // invoke concrete dtor (destructs functor)
-            return static_cast<int>(sizeof (WorkItem));
+            reinterpret_cast<BatchItem*> (workItemStorage)->~BatchItem();
+            return static_cast<int> (sizeof (BatchItem));
         }
 
-        Functor myCall;
+        Functor call;
     };
 
-    /* For clarity (maybe) what's happening here is:
-     1  There are instances of the templated class WorkItem for each type of Functor, and hence
-        multiple versions of myExecAndDestruct.
-     2  When the WorkItem is created the Work::execAndDestructFn pointer is set to
-        point to the appropriate instance of myExecAndDestruct - the pointer is passed
-        to the Work superclass constructor by the WorkItem<Functor> class.
-
-     To call we:
-     -  Get the data from the fifo.
-     -  Cast it to be a Work.
-     -  Call the appropriate instance of myExecAndDestruct
-        via the execAndDestructFn pointer.
-    */
+    /* A call from callfWithPayload().  The payload follows it in the ring, and
+     the exec function reports the size of both so the reader steps over them
+     together. */
+    template <class Functor, class Type>
+    struct PayloadItem : public Work
+    {
+        template <class F>
+        PayloadItem (F&& f, int n, CallQueueLatencyHistogram* h)
+            : Work (&PayloadItem::execAndDestruct),
+              call (std::forward<F> (f)),
+              numItems (n),
+              histogram (h),
+              enqueued (h != nullptr ? Time::getHighResolutionTicks() : 0)
+        {}
 
-    AbstractFifo fifo;
-    char* fifodata;
+        static int getPayloadOffset()
+        {
+            return static_cast<int> ((sizeof (PayloadItem) + alignof (Type) - 1) & ~(alignof (Type) - 1));
+        }
+
+        Type* getPayload()
+        {
+            return reinterpret_cast<Type*> (reinterpret_cast<char*> (this) + getPayloadOffset());
+        }
+
+        static int execAndDestruct (void* workItemStorage)
+        {
+            PayloadItem* that = reinterpret_cast<PayloadItem*> (workItemStorage);
+            const int n = that->numItems;
+
+            if (that->histogram != nullptr)
+                that->histogram->add (Time::getHighResolutionTicks() - that->enqueued);
+
+            that->call (that->getPayload(), n);
+            that->~PayloadItem();
+            return getPayloadOffset() + n * static_cast<int> (sizeof (Type));
+        }
+
+        Functor call;
+        int numItems;
+        CallQueueLatencyHistogram* histogram;
+        int64 enqueued;
+    };
+
+    /* Wraps a call to record how long it spent in the queue. */
+    template <class Functor>
+    struct TimedCall
+    {
+        template <class F>
+        TimedCall (F&& f, CallQueueLatencyHistogram* h)
+            : call (std::forward<F> (f)), histogram (h), enqueued (Time::getHighResolutionTicks())
+        {}
+
+        void operator()()
+        {
+            histogram->add (Time::getHighResolutionTicks() - enqueued);
+            call();
+        }
 
-    /* Used to avoid false sharing and to give correct alignment to embedded structs. */
-    int roundUpToCacheLineBoundary (int x)
+        Functor call;
+        CallQueueLatencyHistogram* histogram;
+        int64 enqueued;
+    };
+
+    /* Records the time a call from callAt() is due.  Like a SkipItem it
+     runs nothing, and the call itself follows it. */
+    struct SampleTimeItem : public Work
     {
-        return x; // TODO
+        explicit SampleTimeItem (int64 position) :
+            Work (&SampleTimeItem::skip),
+            samplePosition (position)
+        {}
+
+        static int skip (void*)
+        {
+            return static_cast<int> (sizeof (SampleTimeItem));
+        }
+
+        int64 samplePosition;
+    };
+
+    static bool isSampleTimeItem (const Work* w)
+    {
+        return w->execAndDestructFn == &SampleTimeItem::skip;
     }
 
-    bool acceptingJobs;
+    static const int64 notScheduled = std::numeric_limits<int64>::min();
+
+    /* The memory the calls are written into. */
+    struct Ring
+    {
+        /* A call that won't fit before the end of the ring is written at the
+         start, with a SkipItem covering the tail, so the ring is exactly size
+         bytes.  The spare cache line lets us start the ring on a cache line
+         boundary. */
+        explicit Ring (int ringSize)
+            :
+            size (ringSize),
+            rawdata (new char[ringSize + cacheLineSize]),
+            finished (false)
+        {
+            data = rawdata.get() + getPaddingForAlignment (rawdata.get(), cacheLineSize);
+        }
+
+        bool lockMemory()
+        {
+            RealtimeMemoryLock::prefault (data, static_cast<size_t> (size));
+            return memoryLock.lock (data, static_cast<size_t> (size));
+        }
+
+        int wrapPosition (int position) const
+        {
+            return position >= size ? position - size : position;
+        }
+
+        int getUsedSpace (int readPos, int writePos) const
+        {
+            return writePos >= readPos ? writePos - readPos : size - readPos + writePos;
+        }
+
+        /* Gap to leave at writePos so the next item is suitably aligned.  An item
+         must lie wholly inside the ring, so if it would run past the end we skip
+         the tail and align from the start of the ring instead.  writePos is always
+         on a cache line boundary, so the gap is always big enough for a SkipItem. */
+        int getPaddingBeforeItem (int writePos, int allocSize, size_t alignment) const
+        {
+            const int padding = getPaddingForAlignment (data + writePos, alignment);
+
+            if (writePos + padding + allocSize <= size)
+                return padding;
+
+            return size - writePos + getPaddingForAlignment (data, alignment);
+        }
+
+        const int size;
+        std::unique_ptr<char[]> rawdata;
+        char* data;
+        RealtimeMemoryLock memoryLock;
+        std::atomic<bool> finished;     /* set once the consumer has moved on to the next ring. */
+
+        JUCE_DECLARE_NON_COPYABLE (Ring)
+    };
+
+    /* The last item grow() writes into the old ring.  Tells the consumer
+     where to carry on. */
+    struct HandoffItem : public Work
+    {
+        HandoffItem (Ring* nextRing, int position)
+            :
+            Work (&HandoffItem::skip),
+            next (nextRing),
+            startPosition (position)
+        {}
+
+        static int skip (void*)
+        {
+            return static_cast<int> (sizeof (HandoffItem));
+        }
+
+        Ring* next;
+        int startPosition;
+    };
+
+    static bool isHandoffItem (const Work* w)
+    {
+        return w->execAndDestructFn == &HandoffItem::skip;
+    }
+
+    /* The first SampleTimeItem or call at the front of the queue, stepping
+     over SkipItems without consuming them, or nullptr if the queue is empty. */
+    Work* peekNextItem()
+    {
+        int readPos = readPosition.value.load (std::memory_order_relaxed);
+
+        while (readPos != cachedWritePosition.value || readPos != refreshWritePosition (readPos))
+        {
+            Work* w = reinterpret_cast<Work*> (readRing.value->data + readPos);
+
+            if (isHandoffItem (w))
+                readPos = moveToNextRing (static_cast<HandoffItem*> (w));
+            else if (isSkipItem (w))
+                readPos = readRing.value->wrapPosition (readPos + roundUpToCacheLineBoundary ((*w->execAndDestructFn) (w)));
+            else
+                return w;
+        }
+
+        return nullptr;
+    }
+
+    /* Execute the call at the front of the queue, stepping over any SkipItem
+     in front of it.  Stops, leaving it in the queue, at a call from callAt()
+     due at or after endSample.  Returns false if nothing was executed. */
+    bool executeNextCall (int64 endSample = std::numeric_limits<int64>::max())
+    {
+        int readPos = readPosition.value.load (std::memory_order_relaxed);
+
+        /* As in post(), only look at the real write position when we've caught
+         up with the one we saw last time. */
+        while (readPos != cachedWritePosition.value || readPos != refreshWritePosition (readPos))
+        {
+            Work* w = reinterpret_cast<Work*> (readRing.value->data + readPos);
+
+            if (isSampleTimeItem (w) && static_cast<SampleTimeItem*> (w)->samplePosition >= endSample)
+                return false;
+
+            if (isHandoffItem (w))
+            {
+                readPos = moveToNextRing (static_cast<HandoffItem*> (w));
+                continue;
+            }
+
+            const bool isCall = ! isSkipItem (w) && ! isSampleTimeItem (w);
+            /* notice only one function pointer invocation here, not two virtual function calls. */
+            const int sizeofWorkItem = (*w->execAndDestructFn) (w);
+            const int allocSize = roundUpToCacheLineBoundary (sizeofWorkItem);
+            readPos = readRing.value->wrapPosition (readPos + allocSize);
+            readPosition.value.store (readPos, std::memory_order_release);
+
+            if (isCall)
+            {
+                increment (callsRead);
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    /* Consumer only.  Fetches the write position, and takes the chance to
+     record how far behind we are for getStatistics().  Not while the old
+     ring is still being drained after a grow(), when the write position may
+     be in the new ring and the read position in the old one. */
+    int refreshWritePosition (int readPos)
+    {
+        const int writePos = writePosition.value.load (std::memory_order_acquire);
+        cachedWritePosition.value = writePos;
+
+        if (bufferSize.load (std::memory_order_relaxed) == readRing.value->size)
+        {
+            const int used = readRing.value->getUsedSpace (readPos, writePos);
+
+            if (used > peakBytesUsed.value.load (std::memory_order_relaxed))
+                peakBytesUsed.value.store (used, std::memory_order_relaxed);
+        }
+
+        return writePos;
+    }
+
+    /* Consumer only.  Switch to the ring after a handoff, and let the
+     producer know it can free the old one. */
+    int moveToNextRing (const HandoffItem* handoff)
+    {
+        Ring* oldRing = readRing.value;
+        const int readPos = handoff->startPosition;
+        readRing.value = handoff->next;
+        readPosition.value.store (readPos, std::memory_order_release);
+
+        /* The handoff lives in the old ring, so this must come last. */
+        oldRing->finished.store (true, std::memory_order_release);
+        return readPos;
+    }
+
+    /* Producer only.  Returns false if the consumer is still using the ring
+     the last grow() replaced. */
+    bool releaseRetiredRing()
+    {
+        if (retiredRing != nullptr)
+        {
+            if (! retiredRing->finished.load (std::memory_order_acquire))
+                return false;
+
+            retiredRing.reset();
+        }
+
+        return true;
+    }
+
+    void wakeConsumerIfParked()
+    {
+        std::atomic_thread_fence (std::memory_order_seq_cst);
+
+        if (consumerParked.value.load (std::memory_order_relaxed)
+            && consumerParked.value.exchange (false, std::memory_order_relaxed))
+            callsAvailable.signal();
+    }
+
+    /* How many times waitAndSynchronize() checks the queue before sleeping. */
+    static const int consumerSpinCount = 1000;
+
+    /* The ring the producer writes to, and the one it replaced until the
+     consumer has finished with it.  Producer only. */
+    std::unique_ptr<Ring> ring;
+    std::unique_ptr<Ring> retiredRing;
+    std::atomic<int> bufferSize;        /* the newest ring's size, for the statistics and getFreeSpace(). */
+    bool lockNewRings;
+    std::atomic<bool> acceptingJobs;
+    const bool consumerCanWait;
+
+    /* The read and write positions get a cache line each.  When they share one, as
+     they do inside AbstractFifo, every callf() on one thread invalidates the line
+     that synchronize() is polling on the other. */
+    PaddedAtomic<int> writePosition;
+    PaddedAtomic<int> readPosition;
+
+    /* Each side's last sight of the other's position, so it only has to
+     touch the other's cache line when it seems to have run out. */
+    PaddedValue<int> cachedReadPosition;    /* producer only. */
+    PaddedValue<int> cachedWritePosition;   /* consumer only. */
+    PaddedValue<Ring*> readRing;            /* consumer only. */
+
+    /* Counters for getNumPendingCalls() and getStatistics(), each written by
+     one side only: peakBytesUsed by the consumer, the rest by whichever
+     side the name suggests. */
+    PaddedAtomic<uint32> callsWritten;
+    PaddedAtomic<uint32> callsRead;
+    PaddedAtomic<uint32> callsDropped;
+    PaddedAtomic<uint32> callsSpilled;
+    PaddedAtomic<int> peakBytesUsed;
+
+    std::atomic<bool> measureLatency;
+    CallQueueLatencyHistogram latencyHistogram;
+
+    /* Producer side only. */
+    OverflowPolicy overflowPolicy;
+    std::list<std::unique_ptr<SpilledCall>> spilledCalls;
+
+    std::unique_ptr<Mailbox[]> mailboxes;
+    int numMailboxes;
+
+    /* Only used if consumerCanWait. */
+    PaddedAtomic<bool> consumerParked;
+    WaitableEvent callsAvailable;
+
+    /* Set by the QueueSet this queue belongs to, if any. */
+    friend class QueueSet;
+    std::atomic<uint64>* readyMask;
+    uint64 readyBit;
 };
 
 
@@ -0,0 +1,153 @@
+/*
+  ==============================================================================
+
+    priority_call_queue.h
+    Created: 17 Oct 2026
+
+  ==============================================================================
+*/
+
+#ifndef PRIORITY_CALL_QUEUE_H_INCLUDED
+#define PRIORITY_CALL_QUEUE_H_INCLUDED
+
+
+/**
+ * @brief A LockFreeCallQueue with a fixed number of priority lanes.
+ *
+ * Use it when urgent calls, like transport changes or all-notes-off, mustn't
+ * wait behind thousands of cosmetic parameter updates.  Lane 0 is the most
+ * urgent.  synchronize() drains the lanes in order, so a call in lane 0 is
+ * run at the next synchronize() however full the other lanes are.
+ *
+ * Each lane can also be given a budget, the most calls synchronize() will
+ * run from it at once.  Budget the busy, unimportant lanes and the time
+ * synchronize() takes stays bounded too.  Whatever is left over stays in
+ * the lane, in order, for next time.
+ *
+ * Each lane is a LockFreeCallQueue in its own right, with the same storage
+ * and the same rules: one producer thread per lane, and synchronize() from a
+ * single consumer thread.  Calls within a lane arrive in order; calls in
+ * different lanes don't.
+ *
+ * @code
+ * enum { urgent, normal, cosmetic };
+ * PriorityCallQueue queue (3, 16384);
+ * queue.setLaneBudget (cosmetic, 64);
+ * ...
+ * queue.callf (urgent, std::bind (&Synth::allNotesOff, &synth));
+ * @endcode
+ */
+class PriorityCallQueue
+{
+public:
+    /**
+     * @param numLanes - the number of priorities.
+     * @param laneBufferSize - size of each lane's queue in bytes.
+     */
+    PriorityCallQueue (int numLanes, int laneBufferSize)
+    {
+        jassert (numLanes > 0);
+
+        for (int i = 0; i < numLanes; ++i)
+        {
+            lanes.add (new LockFreeCallQueue (laneBufferSize));
+            budgets.add (-1);
+        }
+    }
+
+    int getNumLanes() const
+    {
+        return lanes.size();
+    }
+
+    /** @brief Limit the number of calls synchronize() runs from a lane.
+     *
+     * @param maxCallsPerSynchronize - or -1, the default, for no limit.
+     * Set it before the queue is in use.
+     */
+    void setLaneBudget (int lane, int maxCallsPerSynchronize)
+    {
+        budgets.set (lane, maxCallsPerSynchronize);
+    }
+
+    /** @brief Calls a function, via the given lane, on the consumer thread.
+     * @see LockFreeCallQueue::callf() */
+    template <class Functor>
+    bool callf (int lane, Functor&& f)
+    {
+        return getLane (lane).callf (std::forward<Functor> (f));
+    }
+
+    /** @brief Calls object->method (args...) via the given lane.
+     * @see LockFreeCallQueue::callf() */
+    template <class Method, class Object, class... Args>
+    bool callf (int lane, Method method, Object* object, Args const&... args)
+    {
+        return getLane (lane).callf (method, object, args...);
+    }
+
+    /** @brief Execute calls, most urgent lane first, within each lane's budget.
+     *
+     * @returns true if any calls were executed.
+     */
+    bool synchronize()
+    {
+        bool didSomething = false;
+
+        for (int i = 0; i < lanes.size(); ++i)
+        {
+            LockFreeCallQueue& lane = *lanes.getUnchecked (i);
+            const int budget = budgets.getUnchecked (i);
+
+            if (budget < 0)
+                didSomething = lane.synchronize() || didSomething;
+            else
+                didSomething = lane.executeCalls (budget) > 0 || didSomething;
+        }
+
+        return didSomething;
+    }
+
+    /** @brief Return the number of calls waiting in a lane. */
+    int getNumPendingCalls (int lane)
+    {
+        return getLane (lane).getNumPendingCalls();
+    }
+
+    /** @brief The LockFreeCallQueue behind a lane, for its free space,
+     * statistics and so on.  Don't call its synchronize() directly. */
+    LockFreeCallQueue& getLane (int lane)
+    {
+        jassert (isPositiveAndBelow (lane, lanes.size()));
+        return *lanes.getUnchecked (lane);
+    }
+
+    /** Locks every lane's memory.  @see LockFreeCallQueue::lockMemory()
+     * @returns false if any lane couldn't be locked. */
+    bool lockMemory()
+    {
+        bool allLocked = true;
+
+        for (auto* lane : lanes)
+            allLocked = lane->lockMemory() && allLocked;
+
+        return allLocked;
+    }
+
+    /** Stops every lane.  @see LockFreeCallQueue::stop() */
+    void stop()
+    {
+        for (auto* lane : lanes)
+            lane->stop();
+    }
+
+private:
+    OwnedArray<LockFreeCallQueue> lanes;
+    Array<int> budgets;
+
+    JUCE_DECLARE_NON_COPYABLE (PriorityCallQueue)
+};
+
+
+
+#endif  // PRIORITY_CALL_QUEUE_H_INCLUDED
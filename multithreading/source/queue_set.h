@@ -0,0 +1,206 @@
+/*
+  ==============================================================================
+
+    queue_set.h
+    Created: 17 Oct 2026
+
+  ==============================================================================
+*/
+
+#ifndef QUEUE_SET_H_INCLUDED
+#define QUEUE_SET_H_INCLUDED
+
+
+/**
+ * @brief Drains a group of LockFreeCallQueues, visiting only the ones that
+ * have calls waiting.
+ *
+ * An engine hosting many plugin instances, each with a few queues, would
+ * otherwise call synchronize() on every queue every block, and most of them
+ * are empty most of the time.  Each queue added to a QueueSet gets a bit in
+ * a shared mask, which the queue's producer sets whenever it publishes a
+ * call.  synchronize() takes the whole mask in one atomic exchange and only
+ * visits the queues that are flagged, so a block costs the same however
+ * many idle queues there are.
+ *
+ * @code
+ * QueueSet queues;
+ * queues.add (instance->parameterQueue);
+ * queues.add (instance->midiQueue);
+ * ...
+ * // audio thread, once per block
+ * queues.synchronize();
+ * @endcode
+ *
+ *   Watch out for:
+ *   - Up to 64 queues per set.  A big engine can use one set per group of
+ *   instances.
+ *   - Add and remove queues while their producers aren't using them, e.g.
+ *   when an instance is created or prepared, and remove a queue before
+ *   deleting it.
+ *   - The queues keep their own rules: one producer each, and this
+ *   synchronize() counts as their consumer, so don't also synchronize() them
+ *   from another thread.
+ *   - Each call made costs its producer one extra atomic OR on the shared
+ *   mask.
+ */
+class QueueSet
+    : public CacheLineAlignedObject,
+      private CallQueueBase
+{
+public:
+    enum
+    {
+        maxQueues = 64
+    };
+
+    QueueSet() : numQueues (0)
+    {
+        for (auto& q : queues)
+            q = nullptr;
+    }
+
+    ~QueueSet()
+    {
+        for (auto q : queues)
+            if (q != nullptr)
+                q->readyMask = nullptr;
+    }
+
+    /** @brief Add a queue to the set.
+     *
+     * A queue can belong to one set at a time.  Any calls already in it are
+     * run by the next synchronize().
+     *
+     * @returns false if the set already holds maxQueues queues.
+     */
+    bool add (LockFreeCallQueue& queue)
+    {
+        jassert (queue.readyMask == nullptr);
+
+        for (int i = 0; i < maxQueues; ++i)
+        {
+            if (queues[i] == nullptr)
+            {
+                queues[i] = &queue;
+                queue.readyBit = uint64 (1) << i;
+                queue.readyMask = &readyMask.value;
+                ++numQueues;
+
+                readyMask.value.fetch_or (queue.readyBit, std::memory_order_relaxed);
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    /** @brief Take a queue out of the set.  Any calls still in it stay there. */
+    void remove (LockFreeCallQueue& queue)
+    {
+        for (int i = 0; i < maxQueues; ++i)
+        {
+            if (queues[i] == &queue)
+            {
+                queues[i] = nullptr;
+                queue.readyMask = nullptr;
+                --numQueues;
+
+                readyMask.value.fetch_and (~(uint64 (1) << i), std::memory_order_relaxed);
+                return;
+            }
+        }
+    }
+
+    int getNumQueues() const
+    {
+        return numQueues;
+    }
+
+    /** @brief Execute all the calls in every queue that has any.
+     *
+     * Call it on the consumer thread, in place of calling synchronize() on
+     * each queue.
+     *
+     * @returns true if any calls were executed.
+     */
+    bool synchronize()
+    {
+        uint64 ready = readyMask.value.exchange (0, std::memory_order_acquire);
+        bool didSomething = false;
+
+        while (ready != 0)
+        {
+            const int i = lowestSetBit (ready);
+            ready &= ready - 1;
+
+            if (queues[i]->synchronize())
+                didSomething = true;
+        }
+
+        return didSomething;
+    }
+
+    /** @brief Execute up to maxItemsPerQueue calls from each queue that has
+     * any, like LockFreeCallQueue::synchronize (int).
+     *
+     * Queues with calls left over stay flagged for next time.
+     *
+     * @returns the number of queues that still have calls waiting.
+     */
+    int synchronize (int maxItemsPerQueue)
+    {
+        uint64 ready = readyMask.value.exchange (0, std::memory_order_acquire);
+        uint64 stillReady = 0;
+        int numStillReady = 0;
+
+        while (ready != 0)
+        {
+            const uint64 bit = ready & (~ready + 1);
+            const int i = lowestSetBit (ready);
+            ready &= ready - 1;
+
+            if (queues[i]->synchronize (maxItemsPerQueue) > 0)
+            {
+                stillReady |= bit;
+                ++numStillReady;
+            }
+        }
+
+        if (stillReady != 0)
+            readyMask.value.fetch_or (stillReady, std::memory_order_relaxed);
+
+        return numStillReady;
+    }
+
+    /** @brief The flags for queues that have had calls made since they were
+     * last synchronized, bit i for the i'th queue added.  Only a snapshot. */
+    uint64 getReadyMask() const
+    {
+        return readyMask.value.load (std::memory_order_relaxed);
+    }
+
+private:
+    static int lowestSetBit (uint64 x)
+    {
+       #if JUCE_MSVC
+        unsigned long index;
+        _BitScanForward64 (&index, x);
+        return static_cast<int> (index);
+       #else
+        return __builtin_ctzll (x);
+       #endif
+    }
+
+    /* Written by every producer in the set, so it gets a cache line to
+     itself rather than sharing with the queue pointers the consumer reads. */
+    PaddedAtomic<uint64> readyMask;
+    LockFreeCallQueue* queues[maxQueues];
+    int numQueues;
+
+    JUCE_DECLARE_NON_COPYABLE (QueueSet)
+};
+
+
+
+#endif  // QUEUE_SET_H_INCLUDED
@@ -0,0 +1,162 @@
+/*
+  ==============================================================================
+
+    realtime_memory.cpp
+    Created: 17 Oct 2026
+
+  ==============================================================================
+*/
+
+
+std::atomic<int64> RealtimeMemoryLock::totalLockedBytes (0);
+
+size_t RealtimeMemoryLock::getPageSize()
+{
+   #if JUCE_WINDOWS
+    SYSTEM_INFO info;
+    GetSystemInfo (&info);
+    return static_cast<size_t> (info.dwPageSize);
+   #else
+    return static_cast<size_t> (sysconf (_SC_PAGESIZE));
+   #endif
+}
+
+/* The pages a block touches.  Those wholly inside it are its own, but the
+ ones at either end may be shared with a neighbouring block. */
+struct RealtimeMemoryLock::Pages
+{
+    Pages (const void* data, size_t numBytes, size_t size)
+        : pageSize (size)
+    {
+        const size_t begin = reinterpret_cast<size_t> (data);
+        const size_t finish = begin + numBytes;
+
+        start = begin & ~(pageSize - 1);
+        end = (finish + pageSize - 1) & ~(pageSize - 1);
+        innerStart = jmin (end, (begin + pageSize - 1) & ~(pageSize - 1));
+        innerEnd = jmax (innerStart, finish & ~(pageSize - 1));
+    }
+
+    int getNumEndPages() const
+    {
+        return (start < innerStart ? 1 : 0) + (innerEnd < end ? 1 : 0);
+    }
+
+    size_t getEndPage (int index) const
+    {
+        return (index == 0 && start < innerStart) ? start : innerEnd;
+    }
+
+    size_t pageSize, start, end, innerStart, innerEnd;
+};
+
+CriticalSection RealtimeMemoryLock::endPageLock;
+HashMap<pointer_sized_int, int> RealtimeMemoryLock::endPageUsers;
+
+bool RealtimeMemoryLock::lock (void* data, size_t numBytes)
+{
+    unlock();
+
+    if (numBytes == 0)
+        return false;
+
+    /* Round out to whole pages, which is what the OS locks anyway. */
+    const Pages pages (data, numBytes, getPageSize());
+    char* const first = reinterpret_cast<char*> (pages.start);
+
+   #if JUCE_LINUX && defined (MADV_HUGEPAGE)
+    /* Only a hint, and only does anything for the 2MB-aligned parts of a big
+     block.  Must come before the pages are faulted in by mlock(). */
+    if (pages.end - pages.start >= 2 * 1024 * 1024)
+        madvise (first, pages.end - pages.start, MADV_HUGEPAGE);
+   #endif
+
+    const ScopedLock sl (endPageLock);
+
+   #if JUCE_WINDOWS
+    const bool locked = VirtualLock (first, pages.end - pages.start) != 0;
+   #else
+    const bool locked = mlock (first, pages.end - pages.start) == 0;
+   #endif
+
+    if (! locked)
+        return false;
+
+    /* An end page another block has already locked is only counted once. */
+    int64 newlyLocked = static_cast<int64> (pages.innerEnd - pages.innerStart);
+
+    for (int i = 0; i < pages.getNumEndPages(); ++i)
+    {
+        const pointer_sized_int page = static_cast<pointer_sized_int> (pages.getEndPage (i));
+        const int numUsers = endPageUsers[page];
+
+        if (numUsers == 0)
+            newlyLocked += static_cast<int64> (pages.pageSize);
+
+        endPageUsers.set (page, numUsers + 1);
+    }
+
+    lockedData = static_cast<char*> (data);
+    numLockedBytes = numBytes;
+    totalLockedBytes.fetch_add (newlyLocked, std::memory_order_relaxed);
+    return true;
+}
+
+void RealtimeMemoryLock::unlock()
+{
+    if (lockedData == nullptr)
+        return;
+
+    const Pages pages (lockedData, numLockedBytes, getPageSize());
+    const ScopedLock sl (endPageLock);
+
+    /* Locks don't nest, so an end page is only unlocked once the last block
+     sharing it is. */
+    int64 unlocked = static_cast<int64> (pages.innerEnd - pages.innerStart);
+    unlockPages (pages.innerStart, pages.innerEnd);
+
+    for (int i = 0; i < pages.getNumEndPages(); ++i)
+    {
+        const pointer_sized_int page = static_cast<pointer_sized_int> (pages.getEndPage (i));
+        const int numUsers = endPageUsers[page] - 1;
+
+        if (numUsers > 0)
+        {
+            endPageUsers.set (page, numUsers);
+        }
+        else
+        {
+            endPageUsers.remove (page);
+            unlockPages (pages.getEndPage (i), pages.getEndPage (i) + pages.pageSize);
+            unlocked += static_cast<int64> (pages.pageSize);
+        }
+    }
+
+    totalLockedBytes.fetch_sub (unlocked, std::memory_order_relaxed);
+    lockedData = nullptr;
+    numLockedBytes = 0;
+}
+
+void RealtimeMemoryLock::unlockPages (size_t start, size_t end)
+{
+    if (end <= start)
+        return;
+
+   #if JUCE_WINDOWS
+    VirtualUnlock (reinterpret_cast<char*> (start), end - start);
+   #else
+    munlock (reinterpret_cast<char*> (start), end - start);
+   #endif
+}
+
+void RealtimeMemoryLock::prefault (void* data, size_t numBytes)
+{
+    volatile char* const p = static_cast<volatile char*> (data);
+    const size_t pageSize = getPageSize();
+
+    for (size_t i = 0; i < numBytes; i += pageSize)
+        p[i] = p[i];
+
+    if (numBytes > 0)
+        p[numBytes - 1] = p[numBytes - 1];
+}
@@ -0,0 +1,103 @@
+/*
+  ==============================================================================
+
+    realtime_memory.h
+    Created: 17 Oct 2026
+
+  ==============================================================================
+*/
+
+#ifndef REALTIME_MEMORY_H_INCLUDED
+#define REALTIME_MEMORY_H_INCLUDED
+
+
+/**
+ * @brief Keeps a block of memory that a realtime thread uses resident in RAM.
+ *
+ * Freshly allocated memory isn't really there until it's first written to.
+ * Each page costs a page fault the first time it's touched, and if that
+ * happens on the audio thread it happens inside the audio callback.  Memory
+ * that hasn't been used for a while can also be paged out, with the same
+ * result.
+ *
+ * lock() asks the OS to keep a block's pages in RAM (mlock, or VirtualLock on
+ * Windows), and on Linux asks for transparent huge pages for big blocks, so
+ * there are fewer TLB misses too.  prefault() writes to every page of a block
+ * in advance.  The queues and the thread pool use these in their lockMemory()
+ * functions, which are the easier way in.
+ *
+ *   Watch out for:
+ *   - The OS limits how much memory a process may lock (ulimit -l on Linux and
+ *   macOS, the working set size on Windows).  lock() returns false when it
+ *   can't, and the memory is left as it was.
+ *   - Locks work on whole pages, and don't nest.  A page at the end of a
+ *   block that's shared with another locked block stays locked until both
+ *   have been unlocked.  Only RealtimeMemoryLocks are kept track of, so don't
+ *   mlock() the same memory some other way.
+ *
+ * @see getTotalLockedBytes()
+ */
+class RealtimeMemoryLock
+{
+public:
+    RealtimeMemoryLock() : lockedData (nullptr), numLockedBytes (0) {}
+
+    ~RealtimeMemoryLock()
+    {
+        unlock();
+    }
+
+    /** @brief Lock the pages holding a block of memory into RAM.
+     *
+     * Replaces any block this object already holds.  Safe to call while other
+     * threads are using the memory.
+     *
+     * @returns true if the pages were locked.
+     */
+    bool lock (void* data, size_t numBytes);
+
+    /** @brief Let the OS page the block out again. */
+    void unlock();
+
+    bool isLocked() const
+    {
+        return lockedData != nullptr;
+    }
+
+    /** @brief Write to every page of a block of memory now, so its first use
+     * doesn't cause page faults.
+     *
+     * The contents are left as they were, but the pages are written, so call
+     * this before any other thread is using the memory.
+     */
+    static void prefault (void* data, size_t numBytes);
+
+    /** @brief The number of bytes locked by all the RealtimeMemoryLocks in the
+     * process, in whole pages.  A page shared by two blocks is counted once.
+     * For a diagnostics page. */
+    static int64 getTotalLockedBytes()
+    {
+        return totalLockedBytes.load (std::memory_order_relaxed);
+    }
+
+private:
+    struct Pages;
+
+    static size_t getPageSize();
+    static void unlockPages (size_t start, size_t end);
+
+    char* lockedData;
+    size_t numLockedBytes;
+
+    static std::atomic<int64> totalLockedBytes;
+
+    /* How many locked blocks share each end page. */
+    static CriticalSection endPageLock;
+    static HashMap<pointer_sized_int, int> endPageUsers;
+
+    JUCE_DECLARE_NON_COPYABLE (RealtimeMemoryLock)
+};
+
+
+
+#endif  // REALTIME_MEMORY_H_INCLUDED
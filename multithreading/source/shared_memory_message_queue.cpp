@@ -0,0 +1,245 @@
+/*
+  ==============================================================================
+
+    shared_memory_message_queue.cpp
+    Created: 17 Oct 2026
+
+  ==============================================================================
+*/
+
+
+SharedMemoryMessageQueue::SharedMemoryMessageQueue (const String& queueName, int newBufferSize)
+    :
+    name (queueName),
+    header (nullptr),
+    ring (nullptr),
+    bufferSize (roundUpToCacheLineBoundary (newBufferSize)),
+    mappedSize (0),
+    isOwner (true),
+    corrupt (false),
+    cachedReadPosition (0),
+    cachedWritePosition (0)
+{
+    jassert (bufferSize >= 2 * cacheLineSize);
+
+    if (! mapMemory (sizeof (Header) + static_cast<size_t> (bufferSize), true))
+        return;
+
+    header = new (header) Header();
+    header->version = headerVersion;
+    header->bufferSize = bufferSize;
+    ring = reinterpret_cast<char*> (header + 1);
+
+    /* Last, so the other side can't open a half made queue. */
+    header->magic.store (headerMagic, std::memory_order_release);
+}
+
+SharedMemoryMessageQueue::SharedMemoryMessageQueue (const String& queueName)
+    :
+    name (queueName),
+    header (nullptr),
+    ring (nullptr),
+    bufferSize (0),
+    mappedSize (0),
+    isOwner (false),
+    corrupt (false),
+    cachedReadPosition (0),
+    cachedWritePosition (0)
+{
+    if (! mapMemory (0, false))
+        return;
+
+    /* Whatever the other process put in the header, it mustn't take us
+     outside the memory we've mapped. */
+    if (mappedSize < sizeof (Header)
+        || header->magic.load (std::memory_order_acquire) != headerMagic
+        || header->version != headerVersion
+        || header->bufferSize < 2 * cacheLineSize
+        || (header->bufferSize & (cacheLineSize - 1)) != 0
+        || static_cast<size_t> (header->bufferSize) > mappedSize - sizeof (Header))
+    {
+        unmapMemory();
+        return;
+    }
+
+    bufferSize = header->bufferSize;
+    ring = reinterpret_cast<char*> (header + 1);
+    cachedReadPosition = header->readPosition.value.load (std::memory_order_acquire);
+    cachedWritePosition = header->writePosition.value.load (std::memory_order_acquire);
+
+    if (! isValidPosition (cachedReadPosition) || ! isValidPosition (cachedWritePosition))
+        corrupt = true;
+}
+
+SharedMemoryMessageQueue::~SharedMemoryMessageQueue()
+{
+    unmapMemory();
+}
+
+#if JUCE_WINDOWS
+
+bool SharedMemoryMessageQueue::mapMemory (size_t numBytes, bool create)
+{
+    const String mappingName ("Local\\" + name.trimCharactersAtStart ("/"));
+    mappingHandle = nullptr;
+
+    if (create)
+    {
+        const uint64 size = numBytes;
+        mappingHandle = CreateFileMappingW (INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE,
+                                            static_cast<DWORD> (size >> 32), static_cast<DWORD> (size),
+                                            mappingName.toWideCharPointer());
+
+        if (mappingHandle != nullptr && GetLastError() == ERROR_ALREADY_EXISTS)
+        {
+            CloseHandle (mappingHandle);
+            mappingHandle = nullptr;
+        }
+    }
+    else
+    {
+        mappingHandle = OpenFileMappingW (FILE_MAP_ALL_ACCESS, FALSE, mappingName.toWideCharPointer());
+    }
+
+    if (mappingHandle == nullptr)
+        return false;
+
+    void* p = MapViewOfFile (mappingHandle, FILE_MAP_ALL_ACCESS, 0, 0, numBytes);
+
+    if (p == nullptr)
+    {
+        CloseHandle (mappingHandle);
+        mappingHandle = nullptr;
+        return false;
+    }
+
+    MEMORY_BASIC_INFORMATION info;
+    VirtualQuery (p, &info, sizeof (info));
+    mappedSize = create ? numBytes : static_cast<size_t> (info.RegionSize);
+    header = static_cast<Header*> (p);
+    return true;
+}
+
+void SharedMemoryMessageQueue::unmapMemory()
+{
+    if (header != nullptr)
+        UnmapViewOfFile (header);
+
+    if (mappingHandle != nullptr)
+        CloseHandle (mappingHandle);
+
+    header = nullptr;
+    mappingHandle = nullptr;
+}
+
+#else
+
+bool SharedMemoryMessageQueue::mapMemory (size_t numBytes, bool create)
+{
+    const String shmName (name.startsWithChar ('/') ? name : "/" + name);
+
+    fileDescriptor = create ? shm_open (shmName.toRawUTF8(), O_RDWR | O_CREAT | O_EXCL, 0600)
+                            : shm_open (shmName.toRawUTF8(), O_RDWR, 0);
+
+    if (fileDescriptor < 0)
+        return false;
+
+    if (create)
+    {
+        if (ftruncate (fileDescriptor, static_cast<off_t> (numBytes)) != 0)
+        {
+            close (fileDescriptor);
+            shm_unlink (shmName.toRawUTF8());
+            return false;
+        }
+    }
+    else
+    {
+        struct stat info;
+
+        if (fstat (fileDescriptor, &info) != 0 || info.st_size <= 0)
+        {
+            close (fileDescriptor);
+            return false;
+        }
+
+        numBytes = static_cast<size_t> (info.st_size);
+    }
+
+    void* p = mmap (nullptr, numBytes, PROT_READ | PROT_WRITE, MAP_SHARED, fileDescriptor, 0);
+
+    if (p == MAP_FAILED)
+    {
+        close (fileDescriptor);
+
+        if (create)
+            shm_unlink (shmName.toRawUTF8());
+
+        return false;
+    }
+
+    mappedSize = numBytes;
+    header = static_cast<Header*> (p);
+    return true;
+}
+
+void SharedMemoryMessageQueue::unmapMemory()
+{
+    if (header == nullptr)
+        return;
+
+    munmap (header, mappedSize);
+    close (fileDescriptor);
+
+    /* The other process keeps its mapping.  This only stops anyone else
+     opening it. */
+    if (isOwner)
+        shm_unlink ((name.startsWithChar ('/') ? name : "/" + name).toRawUTF8());
+
+    header = nullptr;
+}
+
+#endif
+
+#if JUCE_LINUX
+
+void SharedMemoryMessageQueue::waitForWriter (int timeOutMilliseconds)
+{
+    struct timespec timeout;
+    timeout.tv_sec = timeOutMilliseconds / 1000;
+    timeout.tv_nsec = (timeOutMilliseconds % 1000) * 1000000L;
+
+    /* Not FUTEX_PRIVATE_FLAG, as the writer is in another process.  Returns
+     straight away if the writer has already cleared the flag. */
+    syscall (SYS_futex, reinterpret_cast<uint32*> (&header->consumerWaiting.value), FUTEX_WAIT,
+             1, timeOutMilliseconds >= 0 ? &timeout : nullptr, nullptr, 0);
+}
+
+void SharedMemoryMessageQueue::wakeReader()
+{
+    syscall (SYS_futex, reinterpret_cast<uint32*> (&header->consumerWaiting.value), FUTEX_WAKE,
+             1, nullptr, nullptr, 0);
+}
+
+#else
+
+/* No futex, so poll.  The writer clearing the flag still tells us when to
+ stop. */
+void SharedMemoryMessageQueue::waitForWriter (int timeOutMilliseconds)
+{
+    const uint32 start = Time::getMillisecondCounter();
+
+    while (isEmpty() && header->consumerWaiting.value.load (std::memory_order_relaxed) != 0)
+    {
+        if (timeOutMilliseconds >= 0 && Time::getMillisecondCounter() - start >= static_cast<uint32> (timeOutMilliseconds))
+            break;
+
+        Thread::sleep (1);
+    }
+}
+
+void SharedMemoryMessageQueue::wakeReader()
+{
+}
+
+#endif
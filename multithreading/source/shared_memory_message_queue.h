@@ -0,0 +1,370 @@
+/*
+  ==============================================================================
+
+    shared_memory_message_queue.h
+    Created: 17 Oct 2026
+
+  ==============================================================================
+*/
+
+#ifndef SHARED_MEMORY_MESSAGE_QUEUE_H_INCLUDED
+#define SHARED_MEMORY_MESSAGE_QUEUE_H_INCLUDED
+
+
+/**
+ * @brief A one-way lock-free queue of message records between two
+ * processes, through a named block of shared memory.
+ *
+ * For a plugin host that runs plugins in a separate process: the host's
+ * audio thread and the sandbox can talk as cheaply as two threads talking
+ * through a LockFreeCallQueue.  The ring works the same way: cache line
+ * slots, read and write positions on their own cache lines, and each side
+ * only looks at the other's position when it seems to have run out.
+ * Function pointers mean nothing in another process, so it carries plain
+ * records instead, a type number and a block of bytes, and the consumer
+ * switches on the type.
+ *
+ * One process creates the queue by name and the other opens it.  The
+ * writing side calls write(); the reading side calls synchronize() from the
+ * audio thread, or waitAndSynchronize() from a thread that should sleep
+ * until something arrives.  On Linux the sleeping is done with a futex in
+ * the shared memory, and write() only makes a system call when the reader
+ * is actually asleep.
+ *
+ * @code
+ * enum { noteOn, parameterChange };
+ *
+ * // host
+ * SharedMemoryMessageQueue toSandbox ("/host-1234-to-sandbox", 65536);
+ * toSandbox.write (parameterChange, ParameterChange { 3, 0.5f });
+ *
+ * // sandbox
+ * SharedMemoryMessageQueue fromHost ("/host-1234-to-sandbox");
+ *
+ * fromHost.waitAndSynchronize ([] (int type, const void* data, int numBytes)
+ * {
+ *     if (type == parameterChange && numBytes == sizeof (ParameterChange))
+ *         ...
+ * });
+ * @endcode
+ *
+ *   Watch out for:
+ *   - One writing process and thread, one reading process and thread, as
+ *   with LockFreeCallQueue.
+ *   - Don't trust the other process.  The queue checks the positions and
+ *   record sizes it reads from shared memory, and stops with isValid()
+ *   false if they make no sense, but the contents of a record are up to
+ *   you.  Copy a record out before checking it, as the other process can
+ *   still write to it.
+ *   - Names follow the platform's rules.  Use a leading slash and keep them
+ *   under 31 characters to suit Linux and macOS.
+ *   - waitAndSynchronize() sleeps on a futex on Linux only.  Elsewhere it
+ *   polls every millisecond.
+ *   - Types must be zero or more.  Records are rounded up to whole cache
+ *   lines.
+ */
+class SharedMemoryMessageQueue
+    : private CallQueueBase
+{
+public:
+    /** @brief Create a new queue, which the other process then opens by name.
+     *
+     * Fails, leaving isValid() false, if the name is already in use.  The
+     * name is removed again when this object is deleted.
+     *
+     * @param bufferSize - size of the ring in bytes.
+     */
+    SharedMemoryMessageQueue (const String& name, int bufferSize);
+
+    /** @brief Open a queue the other process has created. */
+    explicit SharedMemoryMessageQueue (const String& name);
+
+    ~SharedMemoryMessageQueue();
+
+    /** @brief false if the queue couldn't be created or opened, or if the
+     * other process has left it in a state that makes no sense. */
+    bool isValid() const
+    {
+        return header != nullptr && ! corrupt;
+    }
+
+    /** @brief Send a record of numBytes bytes.  Writing side only.
+     *
+     * @returns false, and drops the record, if the queue is full.
+     */
+    bool write (int type, const void* recordData, int numBytes)
+    {
+        jassert (type >= 0 && numBytes >= 0);
+
+        if (! isValid())
+            return false;
+
+        const int writePos = header->writePosition.value.load (std::memory_order_relaxed);
+        const int recordSize = roundUpToCacheLineBoundary (static_cast<int> (sizeof (RecordHeader)) + numBytes);
+
+        if (! isValidPosition (writePos))
+        {
+            corrupt = true;
+            return false;
+        }
+
+        /* Records aren't split: one that won't fit before the end of the ring
+         goes at the start, after a skip record. */
+        const bool wraps = writePos + recordSize > bufferSize;
+        const int spaceNeeded = recordSize + (wraps ? bufferSize - writePos : 0);
+
+        if (getFreeSpace (cachedReadPosition, writePos) < spaceNeeded)
+        {
+            cachedReadPosition = header->readPosition.value.load (std::memory_order_acquire);
+
+            if (! isValidPosition (cachedReadPosition))
+            {
+                corrupt = true;
+                return false;
+            }
+
+            if (getFreeSpace (cachedReadPosition, writePos) < spaceNeeded)
+                return false;
+        }
+
+        int recordPos = writePos;
+
+        if (wraps)
+        {
+            writeRecordHeader (writePos, skipRecord, 0);
+            recordPos = 0;
+        }
+
+        writeRecordHeader (recordPos, type, numBytes);
+        memcpy (ring + recordPos + sizeof (RecordHeader), recordData, static_cast<size_t> (numBytes));
+        publish (wrap (recordPos + recordSize));
+        return true;
+    }
+
+    /** @brief write() for a plain struct. */
+    template <class Record>
+    bool write (int type, const Record& record)
+    {
+        static_assert (std::is_trivially_copyable<Record>::value,
+                       "records are copied between processes byte for byte");
+        return write (type, &record, static_cast<int> (sizeof (Record)));
+    }
+
+    /** @brief Pass each waiting record to handler, oldest first.  Reading
+     * side only.
+     *
+     * handler is called as handler (int type, const void* data, int
+     * numBytes), with data pointing into the shared memory.  The record's
+     * space is handed back to the writer as soon as handler returns.
+     *
+     * @returns the number of records handled.
+     */
+    template <class Handler>
+    int synchronize (Handler&& handler)
+    {
+        if (! isValid())
+            return 0;
+
+        int readPos = header->readPosition.value.load (std::memory_order_relaxed);
+        int numHandled = 0;
+
+        /* Only this side writes it, but it lives where the other process can
+         reach it. */
+        if (! isValidPosition (readPos))
+        {
+            corrupt = true;
+            return 0;
+        }
+
+        for (;;)
+        {
+            if (readPos == cachedWritePosition)
+            {
+                cachedWritePosition = header->writePosition.value.load (std::memory_order_acquire);
+
+                if (! isValidPosition (cachedWritePosition))
+                {
+                    corrupt = true;
+                    return numHandled;
+                }
+
+                if (readPos == cachedWritePosition)
+                    return numHandled;
+            }
+
+            /* Copy the header out, so the other process can't change it
+             between checking it and using it. */
+            RecordHeader record;
+            memcpy (&record, ring + readPos, sizeof (RecordHeader));
+
+            const int available = getUsedSpace (readPos, cachedWritePosition);
+
+            if (record.type == skipRecord)
+            {
+                /* A skip only ever runs to the end of the ring, and the writer
+                 has gone on from the start. */
+                if (cachedWritePosition >= readPos)
+                {
+                    corrupt = true;
+                    return numHandled;
+                }
+
+                readPos = 0;
+            }
+            else
+            {
+                const int recordSize = record.numBytes < 0 || record.numBytes > bufferSize ? 0
+                                     : roundUpToCacheLineBoundary (static_cast<int> (sizeof (RecordHeader)) + record.numBytes);
+
+                if (record.type < 0 || recordSize == 0 || recordSize > available || readPos + recordSize > bufferSize)
+                {
+                    corrupt = true;
+                    return numHandled;
+                }
+
+                handler (record.type, static_cast<const void*> (ring + readPos + sizeof (RecordHeader)), record.numBytes);
+                ++numHandled;
+                readPos = wrap (readPos + recordSize);
+            }
+
+            header->readPosition.value.store (readPos, std::memory_order_release);
+        }
+    }
+
+    /** @brief Wait for records to arrive, then handle them.  Reading side
+     * only, and not for the audio thread.
+     *
+     * @param timeOutMilliseconds - give up waiting after this long, or -1 to
+     * wait until something arrives.
+     * @returns the number of records handled.
+     */
+    template <class Handler>
+    int waitAndSynchronize (Handler&& handler, int timeOutMilliseconds = -1)
+    {
+        const int numHandled = synchronize (handler);
+
+        if (numHandled > 0 || ! isValid())
+            return numHandled;
+
+        header->consumerWaiting.value.store (1, std::memory_order_relaxed);
+        /* Pairs with the fence in publish(): either we see the new write
+         position, or the writer sees that we're waiting. */
+        std::atomic_thread_fence (std::memory_order_seq_cst);
+
+        if (isEmpty())
+            waitForWriter (timeOutMilliseconds);
+
+        header->consumerWaiting.value.store (0, std::memory_order_relaxed);
+        return synchronize (handler);
+    }
+
+    bool isEmpty() const
+    {
+        return header == nullptr
+               || header->readPosition.value.load (std::memory_order_acquire)
+                  == header->writePosition.value.load (std::memory_order_acquire);
+    }
+
+    /** @brief The size of the ring in bytes. */
+    int getBufferSize() const
+    {
+        return bufferSize;
+    }
+
+    const String& getName() const
+    {
+        return name;
+    }
+
+private:
+    /* The start of the shared memory.  Only lock-free atomics work between
+     processes, which int32 and uint32 are everywhere JUCE runs. */
+    struct Header
+    {
+        std::atomic<uint32> magic;
+        uint32 version;
+        int32 bufferSize;
+        PaddedAtomic<int32> writePosition;
+        PaddedAtomic<int32> readPosition;
+        PaddedAtomic<uint32> consumerWaiting;   /* the futex. */
+    };
+
+    struct RecordHeader
+    {
+        int32 type;
+        int32 numBytes;
+    };
+
+    static const uint32 headerMagic = 0x43524d51;   /* "CRMQ" */
+    static const uint32 headerVersion = 1;
+    static const int32 skipRecord = -1;
+
+    void writeRecordHeader (int position, int32 type, int32 numBytes)
+    {
+        const RecordHeader record = { type, numBytes };
+        memcpy (ring + position, &record, sizeof (RecordHeader));
+    }
+
+    void publish (int writePos)
+    {
+        header->writePosition.value.store (writePos, std::memory_order_release);
+        std::atomic_thread_fence (std::memory_order_seq_cst);
+
+        if (header->consumerWaiting.value.load (std::memory_order_relaxed) != 0
+            && header->consumerWaiting.value.exchange (0, std::memory_order_relaxed) != 0)
+            wakeReader();
+    }
+
+    bool isValidPosition (int position) const
+    {
+        return position >= 0 && position < bufferSize && (position & (cacheLineSize - 1)) == 0;
+    }
+
+    int wrap (int position) const
+    {
+        return position == bufferSize ? 0 : position;
+    }
+
+    int getUsedSpace (int readPos, int writePos) const
+    {
+        return writePos >= readPos ? writePos - readPos : bufferSize - readPos + writePos;
+    }
+
+    /* As in LockFreeCallQueue, a cache line is always left unused so a full
+     ring can be told from an empty one. */
+    int getFreeSpace (int readPos, int writePos) const
+    {
+        return bufferSize - getUsedSpace (readPos, writePos) - cacheLineSize;
+    }
+
+    /* Platform specific, in the .cpp. */
+    bool mapMemory (size_t numBytes, bool create);
+    void unmapMemory();
+    void waitForWriter (int timeOutMilliseconds);
+    void wakeReader();
+
+    String name;
+    Header* header;
+    char* ring;
+    int bufferSize;
+    size_t mappedSize;
+    bool isOwner;
+    bool corrupt;
+
+    /* This process's last sight of the other side's position.  Each process
+     has its own, so they don't need to be in the shared memory. */
+    int cachedReadPosition;     /* writing side only. */
+    int cachedWritePosition;    /* reading side only. */
+
+   #if JUCE_WINDOWS
+    void* mappingHandle;
+   #else
+    int fileDescriptor;
+   #endif
+
+    JUCE_DECLARE_NON_COPYABLE (SharedMemoryMessageQueue)
+};
+
+
+
+#endif  // SHARED_MEMORY_MESSAGE_QUEUE_H_INCLUDED
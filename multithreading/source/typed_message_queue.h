@@ -0,0 +1,275 @@
+/*
+  ==============================================================================
+
+    typed_message_queue.h
+    Created: 17 Oct 2026
+
+  ==============================================================================
+*/
+
+#ifndef TYPED_MESSAGE_QUEUE_H_INCLUDED
+#define TYPED_MESSAGE_QUEUE_H_INCLUDED
+
+
+/**
+ * @brief A lock-free FIFO of small messages of a few fixed types.
+ *
+ * Where LockFreeCallQueue carries any function call, this carries plain
+ * structs, one of the types listed in Messages.  Use it for the handful of
+ * message shapes that make up most audio thread traffic: parameter changes,
+ * note events, pointer swaps.  Every message takes the same size of slot,
+ * the size of the largest type plus a type index, and the slots are packed
+ * together rather than given a cache line each.  The consumer copies a whole
+ * run of messages out with pop() and switches on each one's type, rather
+ * than making an indirect call per message.
+ *
+ * @code
+ * struct SetParam { int index; float value; };
+ * struct NoteOn   { int note; float velocity; };
+ * struct SwapSample { SampleBuffer* buffer; };
+ *
+ * typedef TypedMessageQueue<SetParam, NoteOn, SwapSample> Messages;
+ * Messages messages (1024);
+ *
+ * // message thread
+ * messages.push (SetParam { 3, 0.5f });
+ *
+ * // audio thread
+ * Messages::Message received[64];
+ * const int n = messages.pop (received, 64);
+ *
+ * for (int i = 0; i < n; ++i)
+ * {
+ *     switch (received[i].getType())
+ *     {
+ *         case Messages::typeOf<SetParam>(): setParameter (received[i].get<SetParam>()); break;
+ *         case Messages::typeOf<NoteOn>():   startNote (received[i].get<NoteOn>()); break;
+ *         ...
+ *     }
+ * }
+ * @endcode
+ *
+ * Like LockFreeCallQueue this is one-writer, one-reader: push() from a
+ * single thread, pop() from a single other thread.
+ *
+ *   Watch out for:
+ *   - The message types must be trivially copyable, as messages are copied
+ *   around with memcpy and never destroyed.  Pass objects by pointer and use
+ *   the GarbageCollector to delete them.
+ *   - A big message type makes every slot big, so send big things by pointer.
+ *   - The capacity is rounded up to a power of two.
+ */
+template <class... Messages>
+class TypedMessageQueue
+    : public CacheLineAlignedObject,
+      private CallQueueBase
+{
+    /* Compile time helpers.  They have to come before Message. */
+    template <class Msg, class... List>
+    struct IndexOf;
+
+    template <class Msg, class... Rest>
+    struct IndexOf<Msg, Msg, Rest...>
+    {
+        static const int value = 0;
+    };
+
+    template <class Msg, class First, class... Rest>
+    struct IndexOf<Msg, First, Rest...>
+    {
+        static const int value = 1 + IndexOf<Msg, Rest...>::value;
+    };
+
+    template <size_t... Values>
+    struct Largest;
+
+    template <size_t Only>
+    struct Largest<Only>
+    {
+        static const size_t value = Only;
+    };
+
+    template <size_t First, size_t Second, size_t... Rest>
+    struct Largest<First, Second, Rest...>
+    {
+        static const size_t value = Largest<(First > Second ? First : Second), Rest...>::value;
+    };
+
+public:
+    /** @brief The number pop() reports for messages of type Msg, for use as a
+     * case label. */
+    template <class Msg>
+    static constexpr int typeOf()
+    {
+        return IndexOf<Msg, Messages...>::value;
+    }
+
+    /** @brief One message, as copied out by pop(). */
+    class Message
+    {
+    public:
+        int getType() const
+        {
+            return type;
+        }
+
+        template <class Msg>
+        bool is() const
+        {
+            return type == typeOf<Msg>();
+        }
+
+        template <class Msg>
+        const Msg& get() const
+        {
+            jassert (is<Msg>());
+            return *reinterpret_cast<const Msg*> (&storage);
+        }
+
+    private:
+        friend class TypedMessageQueue;
+
+        typename std::aligned_storage<Largest<sizeof (Messages)...>::value,
+                                      Largest<alignof (Messages)...>::value>::type storage;
+        int type;
+    };
+
+    /**
+     * @param capacity - the number of messages the queue can hold.  Rounded up
+     * to a power of two.
+     */
+    explicit TypedMessageQueue (int capacity)
+        :
+        numSlots (roundUpToPowerOfTwo (capacity))
+    {
+        const size_t numBytes = sizeof (Message) * numSlots;
+        rawdata = new char[numBytes + cacheLineSize];
+        slots = reinterpret_cast<Message*> (rawdata + getPaddingForAlignment (rawdata, cacheLineSize));
+    }
+
+    ~TypedMessageQueue()
+    {
+        memoryLock.unlock();
+        delete [] rawdata;
+    }
+
+    /** @brief Add a message to the queue.  Producer thread only.
+     *
+     * @returns false, and drops the message, if the queue is full.
+     */
+    template <class Msg>
+    bool push (const Msg& message)
+    {
+        static_assert (std::is_trivially_copyable<Msg>::value,
+                       "TypedMessageQueue messages must be trivially copyable");
+
+        const uint32 writePos = writePosition.value.load (std::memory_order_relaxed);
+
+        /* As in LockFreeCallQueue, only look at the consumer's position when
+         the queue seems to be full. */
+        if (writePos - cachedReadPosition.value >= numSlots)
+        {
+            cachedReadPosition.value = readPosition.value.load (std::memory_order_acquire);
+
+            if (writePos - cachedReadPosition.value >= numSlots)
+                return false;
+        }
+
+        Message& slot = slots[writePos & (numSlots - 1)];
+        new (&slot.storage) Msg (message);
+        slot.type = typeOf<Msg>();
+
+        writePosition.value.store (writePos + 1, std::memory_order_release);
+        return true;
+    }
+
+    /** @brief Copy up to maxMessages messages, oldest first, into destination
+     * and remove them from the queue.  Consumer thread only.
+     *
+     * The whole run is copied and then released with a single store, so
+     * draining the queue costs the same cross-thread traffic however many
+     * messages there are.
+     *
+     * @returns the number of messages copied.
+     */
+    int pop (Message* destination, int maxMessages)
+    {
+        const uint32 readPos = readPosition.value.load (std::memory_order_relaxed);
+
+        if (cachedWritePosition.value - readPos < static_cast<uint32> (maxMessages))
+            cachedWritePosition.value = writePosition.value.load (std::memory_order_acquire);
+
+        const int numMessages = static_cast<int> (jmin (cachedWritePosition.value - readPos,
+                                                        static_cast<uint32> (maxMessages)));
+
+        if (numMessages == 0)
+            return 0;
+
+        /* At most two runs: up to the end of the ring, then from the start. */
+        const int start = static_cast<int> (readPos & (numSlots - 1));
+        const int firstRun = jmin (numMessages, static_cast<int> (numSlots) - start);
+        memcpy (destination, slots + start, sizeof (Message) * static_cast<size_t> (firstRun));
+        memcpy (destination + firstRun, slots, sizeof (Message) * static_cast<size_t> (numMessages - firstRun));
+
+        readPosition.value.store (readPos + static_cast<uint32> (numMessages), std::memory_order_release);
+        return numMessages;
+    }
+
+    /** @brief return true if the queue is empty. */
+    bool isEmpty() const
+    {
+        return readPosition.value.load (std::memory_order_acquire)
+               == writePosition.value.load (std::memory_order_acquire);
+    }
+
+    /** @brief Return the number of messages waiting.  Only a snapshot if the
+     * other thread is running. */
+    int getNumMessages() const
+    {
+        return static_cast<int> (writePosition.value.load (std::memory_order_acquire)
+                                 - readPosition.value.load (std::memory_order_acquire));
+    }
+
+    int getCapacity() const
+    {
+        return static_cast<int> (numSlots);
+    }
+
+    /** @brief Fault in the queue's memory and lock it into RAM.  Call it
+     * before the queue is in use.  @see LockFreeCallQueue::lockMemory() */
+    bool lockMemory()
+    {
+        RealtimeMemoryLock::prefault (slots, sizeof (Message) * numSlots);
+        return memoryLock.lock (slots, sizeof (Message) * numSlots);
+    }
+
+private:
+    static uint32 roundUpToPowerOfTwo (int x)
+    {
+        uint32 n = 1;
+
+        while (n < static_cast<uint32> (x))
+            n <<= 1;
+
+        return n;
+    }
+
+    const uint32 numSlots;
+    char* rawdata;
+    Message* slots;
+    RealtimeMemoryLock memoryLock;
+
+    /* Free running counters, masked to find the slot, so a full queue can use
+     every slot. */
+    PaddedAtomic<uint32> writePosition;
+    PaddedAtomic<uint32> readPosition;
+
+    PaddedValue<uint32> cachedReadPosition;     /* producer only. */
+    PaddedValue<uint32> cachedWritePosition;    /* consumer only. */
+
+    JUCE_DECLARE_NON_COPYABLE (TypedMessageQueue)
+};
+
+
+
+#endif  // TYPED_MESSAGE_QUEUE_H_INCLUDED
@@ -44,7 +44,8 @@ private:
  * of CriticalThreadValueTree
  */
 class CriticalThreadValueTree :
-    public ValueTree::Listener
+    public ValueTree::Listener,
+    private Timer
 {
 private:
     /** @internal */
@@ -95,6 +96,12 @@ public:
      * synchronisation.  You will need to regularly call synchronise on the
      * LockFreeCallQueue from the critical thread so that the ValueTree gets
      * updated.
+     *
+     * If a burst of changes could fill the queue, set its overflow policy to
+     * LockFreeCallQueue::spillToHeap, so changes wait on the message thread
+     * instead of being lost.  Whatever is spilled is posted from a timer as
+     * the critical thread makes room, so the last changes of a burst get
+     * through even if nothing else changes afterwards.
      */
     CriticalThreadValueTree (ValueTree source, LockFreeCallQueue& q) :
         jobsForCriticalThread (q)
@@ -104,7 +111,9 @@ public:
     }
 
     ~CriticalThreadValueTree()
-    {}
+    {
+        stopTimer();
+    }
 
     /** @brief set the source tree to copy.  This is set initally by the
      * constructor, so you may not need to call this function. */
@@ -221,6 +230,7 @@ private:
         jobsForCriticalThread.callf (std::bind (&CriticalThreadValueTree::updatePropertyOnCriticalThread,
                                                 this,
                                                 target, property, value));
+        flushLaterIfSpilled();
     }
 
     void updatePropertyOnCriticalThread (ValueTree target, Identifier property, var value)
@@ -235,6 +245,21 @@ private:
         jobsForCriticalThread.callf (std::bind (&CriticalThreadValueTree::replaceValueTree,
                                                 this,
                                                 p));
+        flushLaterIfSpilled();
+    }
+
+    /** With the spillToHeap policy, keep posting spilled changes until
+     they're all through.  The timer only runs while there are some. */
+    void flushLaterIfSpilled()
+    {
+        if (jobsForCriticalThread.getNumSpilledCalls() > 0 && ! isTimerRunning())
+            startTimer (flushInterval);
+    }
+
+    void timerCallback()
+    {
+        if (jobsForCriticalThread.flushSpilledCalls())
+            stopTimer();
     }
     
     void replaceValueTree (typename ValueTreeCopy::Ptr replacementTree)
@@ -244,6 +269,8 @@ private:
         readonly = replacementTree;
     }
 
+    enum { flushInterval = 10 };  /* ms */
+
     ValueTreeLinkCache linkCache;
     LockFreeCallQueue& jobsForCriticalThread;
     ValueTree sourceTree;
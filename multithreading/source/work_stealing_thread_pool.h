@@ -0,0 +1,473 @@
+/*
+  ==============================================================================
+
+    work_stealing_thread_pool.h
+    Created: 17 Oct 2026
+
+  ==============================================================================
+*/
+
+#ifndef WORK_STEALING_THREAD_POOL_H_INCLUDED
+#define WORK_STEALING_THREAD_POOL_H_INCLUDED
+
+
+/**
+ * @brief A pool of worker threads that balance the load by stealing tasks
+ * from each other.  For offline rendering, sample decoding and other
+ * background jobs that split into lots of small pieces.
+ *
+ * Tasks are stored the same way as calls in LockFreeCallQueue: the functor
+ * is copied straight into a fixed-size slot with a single function pointer
+ * to run and destroy it.  There's no per-task allocation.
+ *
+ * Each worker owns a deque.  Tasks submitted from inside a task go on the
+ * back of the current worker's deque, and the worker takes them back off the
+ * back, so related work stays on one core.  An idle worker steals from the
+ * front of someone else's deque.  Tasks submitted from any other thread go
+ * via a MultiProducerCallQueue to one of the workers (round robin), which
+ * moves them onto its deque where they can be stolen like any other.
+ *
+ @code
+ WorkStealingThreadPool pool (SystemStats::getNumCpus());
+
+ for (int i = 0; i < numFiles; ++i)
+     pool.submit (std::bind (&SampleLibrary::decode, &library, i));
+
+ pool.waitForAll();
+ @endcode
+ *
+ *   Watch out for:
+ *   - Each task must fit in a slot (maxTaskSize bytes).  Capture a pointer
+ *   to a bigger object instead.
+ *   - submit() from outside the pool returns false if that worker's
+ *   submission queue is full.  From inside a task it always succeeds: if the
+ *   deque is full the task is simply run there and then.
+ *   - The destructor waits for all the tasks to finish.
+ */
+class WorkStealingThreadPool
+    : private CallQueueBase
+{
+public:
+    enum
+    {
+        taskStorageSize = 112,
+        /** Largest functor a task can hold (a WorkItem adds a pointer). */
+        maxTaskSize = taskStorageSize - sizeof (Work)
+    };
+
+    /**
+     * @param numWorkers - number of threads to start.
+     * @param tasksPerWorker - capacity of each worker's deque.  Rounded up to a
+     * power of two.
+     * @param submissionQueueSize - size, in bytes, of each worker's queue for
+     * tasks submitted from other threads.
+     */
+    WorkStealingThreadPool (int numWorkers, int tasksPerWorker = 1024, int submissionQueueSize = 65536)
+        : numPending (0),
+          numSleeping (0),
+          nextWorkerForSubmission (0)
+    {
+        jassert (numWorkers > 0);
+
+        for (int i = 0; i < numWorkers; ++i)
+            workers.add (new Worker (*this, i, tasksPerWorker, submissionQueueSize));
+
+        for (auto* w : workers)
+            w->startThread();
+    }
+
+    ~WorkStealingThreadPool()
+    {
+        waitForAll();
+
+        for (auto* w : workers)
+            w->signalThreadShouldExit();
+
+        for (auto* w : workers)
+        {
+            w->wakeUp.signal();
+            w->stopThread (1000);
+        }
+    }
+
+    /** @brief Queue a task to run on one of the workers.
+     *
+     * @returns false if the task couldn't be queued. Only possible when
+     * submitting from outside the pool.
+     */
+    template <class Functor>
+    bool submit (Functor const& f)
+    {
+        static_assert (sizeof (WorkItem<Functor>) <= sizeof (Task::storage),
+                       "Functor too big for a WorkStealingThreadPool task, capture a pointer to it instead");
+        static_assert (alignof (WorkItem<Functor>) <= alignof (Task),
+                       "Functor alignment too big for a WorkStealingThreadPool task");
+
+        numPending.fetch_add (1, std::memory_order_relaxed);
+
+        if (Worker* w = getCurrentWorker())
+        {
+            if (! w->push (f))
+            {
+                f();
+                taskFinished();
+                return true;
+            }
+
+            wakeIdleWorker();
+            return true;
+        }
+
+        const int numWorkers = workers.size();
+        const int start = static_cast<int> (nextWorkerForSubmission.fetch_add (1, std::memory_order_relaxed) % numWorkers);
+
+        for (int i = 0; i < numWorkers; ++i)
+        {
+            Worker* target = workers.getUnchecked ((start + i) % numWorkers);
+
+            /* Not std::bind: it would call f, rather than pass it on, if f were
+             itself a bind expression. */
+            if (target->submissions.callf ([target, f] { target->pushSubmittedTask (f); }))
+            {
+                target->wakeIfSleeping();
+                return true;
+            }
+        }
+
+        taskFinished();
+        return false;
+    }
+
+    /** @brief Block until every task submitted so far, and any tasks they
+     * submit, has finished.  Don't call this from inside a task. */
+    void waitForAll()
+    {
+        jassert (getCurrentWorker() == nullptr);
+
+        while (numPending.load (std::memory_order_acquire) > 0)
+            allDone.wait (10);
+    }
+
+    /** @brief Number of tasks submitted that haven't finished yet. */
+    int getNumPendingTasks() const
+    {
+        return numPending.load (std::memory_order_acquire);
+    }
+
+    int getNumWorkers() const
+    {
+        return workers.size();
+    }
+
+    /** @brief Ask the OS to keep the workers' task storage and submission
+     * queues in RAM.  @see LockFreeCallQueue::lockMemory()
+     * @returns false if any of it couldn't be locked. */
+    bool lockMemory()
+    {
+        bool allLocked = true;
+
+        for (auto* w : workers)
+            allLocked = w->lockMemory() && allLocked;
+
+        return allLocked;
+    }
+
+private:
+    /** One slot in a worker's deque.  Whoever takes a task moves it out of the
+     slot before running it, so the slot is free again straight away and the
+     task can submit more work to the same deque.  occupied stays set until
+     the move is done, so the owner never reuses a slot a thief is still
+     copying from. */
+    struct alignas (cacheLineSize) Task
+        : public CacheLineAlignedObject
+    {
+        Task() : occupied (false), relocate (nullptr) {}
+        std::atomic<bool> occupied;
+        void (*relocate) (void* from, void* to);
+        alignas (16) char storage[taskStorageSize];
+    };
+
+    template <class Functor>
+    static void relocateWorkItem (void* from, void* to)
+    {
+        WorkItem<Functor>* item = static_cast<WorkItem<Functor>*> (from);
+        new (to) WorkItem<Functor> (std::move (*item));
+        item->~WorkItem<Functor>();
+    }
+
+    /** A bounded work-stealing deque, after Chase & Lev, with the C11 memory
+     orderings from Le et al. "Correct and Efficient Work-Stealing for Weak
+     Memory Models" (2013).  Tasks are moved out of their slot to run, see Task. */
+    class Worker
+        : public Thread,
+          public CacheLineAlignedObject
+    {
+    public:
+        Worker (WorkStealingThreadPool& p, int workerIndex, int numTasks, int submissionQueueSize)
+            : Thread ("Pool Worker " + String (workerIndex)),
+              pool (p),
+              submissions (submissionQueueSize),
+              wakeUp (false),
+              sleeping (false),
+              capacity (roundUpToPowerOfTwo (numTasks)),
+              tasks (new Task[capacity]),
+              randomSeed (static_cast<uint32> (workerIndex) * 2654435761u + 1)
+        {
+            top.value = 0;
+            bottom.value = 0;
+        }
+
+        ~Worker()
+        {
+            taskLock.unlock();
+            delete [] tasks;
+        }
+
+        /* The Tasks have all been constructed, so they're already faulted in. */
+        bool lockMemory()
+        {
+            const bool tasksLocked = taskLock.lock (tasks, sizeof (Task) * static_cast<size_t> (capacity));
+            return submissions.lockMemory() && tasksLocked;
+        }
+
+        void run() override
+        {
+            int idleCount = 0;
+
+            while (! threadShouldExit())
+            {
+                if (runOwnTask() || submissions.synchronize() || stealAndRunTask())
+                {
+                    idleCount = 0;
+                    continue;
+                }
+
+                /* Spin for a bit before going to sleep, work usually comes in bursts. */
+                if (++idleCount < 64)
+                {
+                    yield();
+                    continue;
+                }
+
+                sleeping.store (true, std::memory_order_seq_cst);
+                pool.numSleeping.fetch_add (1, std::memory_order_seq_cst);
+
+                /* Look once more, in case work arrived just before we set the flag.
+                 The timeout covers anything that still slips through. */
+                if (! pool.isThereAnyWork())
+                    wakeUp.wait (20);
+
+                pool.numSleeping.fetch_sub (1, std::memory_order_seq_cst);
+                sleeping.store (false, std::memory_order_seq_cst);
+                idleCount = 0;
+            }
+        }
+
+        /* Owner only. */
+        template <class Functor>
+        bool push (Functor const& f)
+        {
+            const int64 b = bottom.value.load (std::memory_order_relaxed);
+            const int64 t = top.value.load (std::memory_order_acquire);
+            Task& task = tasks[b & (capacity - 1)];
+
+            if (b - t >= capacity || task.occupied.load (std::memory_order_acquire))
+                return false;
+
+            new (task.storage) WorkItem<Functor> (f);
+            task.relocate = &relocateWorkItem<Functor>;
+            task.occupied.store (true, std::memory_order_relaxed);
+            bottom.value.store (b + 1, std::memory_order_release);
+            return true;
+        }
+
+        /* Runs on this worker, from synchronize(), for tasks that came in from
+         outside the pool. */
+        template <class Functor>
+        void pushSubmittedTask (Functor const& f)
+        {
+            if (push (f))
+            {
+                pool.wakeIdleWorker();
+                return;
+            }
+
+            f();
+            pool.taskFinished();
+        }
+
+        /* Owner only.  Take from the back. */
+        bool runOwnTask()
+        {
+            const int64 b = bottom.value.load (std::memory_order_relaxed) - 1;
+            bottom.value.store (b, std::memory_order_relaxed);
+            std::atomic_thread_fence (std::memory_order_seq_cst);
+            int64 t = top.value.load (std::memory_order_relaxed);
+
+            if (t > b)
+            {
+                bottom.value.store (b + 1, std::memory_order_relaxed);
+                return false;
+            }
+
+            if (t == b)
+            {
+                /* Last one - race any thieves for it. */
+                const bool won = top.value.compare_exchange_strong (t, t + 1, std::memory_order_seq_cst,
+                                                                    std::memory_order_relaxed);
+                bottom.value.store (b + 1, std::memory_order_relaxed);
+
+                if (! won)
+                    return false;
+            }
+
+            runTask (tasks[b & (capacity - 1)]);
+            return true;
+        }
+
+        /* Any thread.  Take from the front. */
+        bool steal()
+        {
+            int64 t = top.value.load (std::memory_order_acquire);
+            std::atomic_thread_fence (std::memory_order_seq_cst);
+            const int64 b = bottom.value.load (std::memory_order_acquire);
+
+            if (t >= b)
+                return false;
+
+            if (! top.value.compare_exchange_strong (t, t + 1, std::memory_order_seq_cst,
+                                                     std::memory_order_relaxed))
+                return false;
+
+            runTask (tasks[t & (capacity - 1)]);
+            return true;
+        }
+
+        bool hasTasks()
+        {
+            return top.value.load (std::memory_order_acquire) < bottom.value.load (std::memory_order_acquire)
+                   || ! submissions.isEmpty();
+        }
+
+        void wakeIfSleeping()
+        {
+            std::atomic_thread_fence (std::memory_order_seq_cst);
+
+            if (sleeping.load (std::memory_order_seq_cst))
+                wakeUp.signal();
+        }
+
+        WorkStealingThreadPool& pool;
+        MultiProducerCallQueue submissions;
+        WaitableEvent wakeUp;
+        std::atomic<bool> sleeping;
+
+    private:
+        void runTask (Task& task)
+        {
+            alignas (16) char local[taskStorageSize];
+            (*task.relocate) (task.storage, local);
+            task.occupied.store (false, std::memory_order_release);
+
+            Work* w = reinterpret_cast<Work*> (local);
+            (*w->execAndDestructFn) (w);
+            pool.taskFinished();
+        }
+
+        bool stealAndRunTask()
+        {
+            const int numWorkers = pool.workers.size();
+
+            if (numWorkers < 2)
+                return false;
+
+            /* Start somewhere random so thieves don't all pile onto worker 0. */
+            randomSeed = randomSeed * 1664525u + 1013904223u;
+            const int start = static_cast<int> ((randomSeed >> 8) % static_cast<uint32> (numWorkers));
+
+            for (int i = 0; i < numWorkers; ++i)
+            {
+                Worker* victim = pool.workers.getUnchecked ((start + i) % numWorkers);
+
+                if (victim != this && victim->steal())
+                    return true;
+            }
+
+            return false;
+        }
+
+        static int64 roundUpToPowerOfTwo (int x)
+        {
+            int64 n = 2;
+
+            while (n < x)
+                n <<= 1;
+
+            return n;
+        }
+
+        const int64 capacity;
+        Task* tasks;
+        RealtimeMemoryLock taskLock;
+        uint32 randomSeed;
+
+        /* Thieves contend on top, the owner works on bottom. */
+        PaddedAtomic<int64> top;
+        PaddedAtomic<int64> bottom;
+
+        JUCE_DECLARE_NON_COPYABLE (Worker)
+    };
+
+    Worker* getCurrentWorker() const
+    {
+        Worker* w = dynamic_cast<Worker*> (Thread::getCurrentThread());
+        return (w != nullptr && &w->pool == this) ? w : nullptr;
+    }
+
+    bool isThereAnyWork()
+    {
+        for (auto* w : workers)
+            if (w->hasTasks())
+                return true;
+
+        return false;
+    }
+
+    /** Called after pushing a task that someone else could steal. */
+    void wakeIdleWorker()
+    {
+        /* Pairs with the sleeping worker's last look for work: either it sees
+         our task, or we see it's asleep. */
+        std::atomic_thread_fence (std::memory_order_seq_cst);
+
+        if (numSleeping.load (std::memory_order_seq_cst) == 0)
+            return;
+
+        for (auto* w : workers)
+        {
+            if (w->sleeping.load (std::memory_order_seq_cst))
+            {
+                w->wakeUp.signal();
+                return;
+            }
+        }
+    }
+
+    void taskFinished()
+    {
+        if (numPending.fetch_sub (1, std::memory_order_acq_rel) == 1)
+            allDone.signal();
+    }
+
+    OwnedArray<Worker> workers;
+    std::atomic<int> numPending;
+    std::atomic<int> numSleeping;
+    std::atomic<uint32> nextWorkerForSubmission;
+    WaitableEvent allDone;
+
+    JUCE_DECLARE_NON_COPYABLE (WorkStealingThreadPool)
+};
+
+
+
+#endif  // WORK_STEALING_THREAD_POOL_H_INCLUDED